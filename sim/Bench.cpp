@@ -0,0 +1,492 @@
+//======================================
+// Host microbenchmarks for the control-path
+// primitives. Compiles the robot code from
+// src/ against the simulator backend and
+// times each primitive in a tight loop.
+//
+//   g++ -std=c++11 -O2 -DHAL_SIM sim/Bench.cpp sim/Simulator.cpp -o okarito_bench
+//   ./okarito_bench                            print results
+//   ./okarito_bench sim/BenchBaseline.txt      fail on regressions
+//   ./okarito_bench -w sim/BenchBaseline.txt   record a new baseline
+//
+// Anything that reads a sensor or encoder
+// also pays for the simulator: every read
+// advances the simulated clock and steps the
+// physics. The halGetSensor row measures that
+// overhead on its own. The approachStep row
+// is the work of one realTimeApproach tick,
+// and the approachTick row adds the
+// executive's wait for the next tick, which is
+// simulated. The mpcPlan row is the planner on
+// its own, which is the part that has to fit
+// in a tick.
+//
+// The approachTick row also prints the
+// executive's statistics in simulated time:
+// how long a tick's work took and how many
+// ticks overran.
+//
+// Allocations are counted by wrapping the
+// glibc allocator, so they include anything
+// the C++ runtime does on our behalf.
+//
+// Every run of a benchmark is paired with a
+// run of a fixed calibration loop, and the
+// baseline keeps both. A comparison scales the
+// baseline by how fast the calibration loop
+// runs now, so a baseline recorded on one
+// machine can be checked on another, and a
+// busy host slows both halves alike.
+//======================================
+
+#include "RobotC.h"
+#include "../src/DriveBase.c"
+
+#include <cstring>
+
+// A run fails if it is this much slower than
+// its baseline, plus a little absolute slack
+// for the primitives that take a nanosecond.
+const double BENCH_TOLERANCE = 1.5;
+const double BENCH_SLACK_NS = 2;
+
+const int BENCH_REPEATS = 5;
+const int BENCH_MAX_RESULTS = 32;
+const int BENCH_CALIBRATE_ITERATIONS = 200000;
+
+//======================================
+// Allocation counting
+//======================================
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static long allocations = 0;
+
+extern "C" void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+//======================================
+// Benchmarks
+//======================================
+
+// Keeps the compiler from throwing the
+// results away.
+static volatile float sink;
+
+// Inputs that change every iteration so the
+// primitives can't be folded into constants.
+static float inputs[256];
+
+static SimWorld world;
+static Robot robot;
+
+/**
+ * The calibration loop. It does the kind of
+ * work the control code does, dependent float
+ * arithmetic and a branch, without touching
+ * the robot or the simulator.
+ */
+static void benchCalibrate(int n) {
+    float x = 0;
+    for(int i = 0; i < n; i++) {
+        x = x * 0.999f + inputs[i & 255];
+        if(x > 1000) {
+            x -= 1000;
+        }
+    }
+    sink = x;
+}
+
+/**
+ * Puts the world and the robot back at the
+ * start of an approach: robot in the middle of
+ * the arena, beacon straight ahead.
+ */
+static void benchSetup() {
+    simInit(world, 115, 40, 90, 115, 200);
+    simBind(world);
+
+    robotInit(robot);
+    driveInit(robot);
+    lightHouseInit(robot);
+
+    world.towerDeg = 180;
+    world.headDeg = 180;
+    robot.photosensorDefaultValue = halGetSensor(lightSensor);
+}
+
+static void benchSign(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += sign(inputs[i & 255]);
+    }
+    sink = sum;
+}
+
+static void benchClamp(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += clamp(inputs[i & 255], 50);
+    }
+    sink = sum;
+}
+
+static void benchClamp2(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += clamp2(inputs[i & 255], -20, 50);
+    }
+    sink = sum;
+}
+
+/**
+ * Times PIDCalculate on its own. The refresh
+ * wait is turned off, and the slew rate is
+ * either huge (never clamps) or small enough
+ * to clamp every tick.
+ */
+static void benchPID(int n, float slewRate) {
+    PID pid;
+    PIDInit(pid, 1.5, 0.01, 100, 127, 0, slewRate, true, 0);
+    PIDReset(pid);
+
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        world.timeUs += 1000;
+        sum += PIDCalculate(pid, inputs[i & 255]);
+    }
+    sink = sum;
+}
+
+static void benchPIDNoSlew(int n) {
+    benchPID(n, 99999);
+}
+
+static void benchPIDSlew(int n) {
+    benchPID(n, 0.01);
+}
+
+static void benchPIDFilter(int n, float slewRate) {
+    PID pid;
+    PIDInit(pid, 1, 0, 0, 127, 0, slewRate, true, 0);
+    PIDReset(pid);
+    pid.dTime = 1;
+
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        pid.output = inputs[i & 255];
+        sum += PIDFilter(pid);
+    }
+    sink = sum;
+}
+
+static void benchPIDFilterNoSlew(int n) {
+    benchPIDFilter(n, 99999);
+}
+
+static void benchPIDFilterSlew(int n) {
+    benchPIDFilter(n, 0.01);
+}
+
+static void benchHalRead(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += halGetSensor(testing);
+    }
+    sink = sum;
+}
+
+static void benchLeftLight(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += getLeftLight(robot);
+    }
+    sink = sum;
+}
+
+static void benchRightLight(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += getRightLight(robot);
+    }
+    sink = sum;
+}
+
+static void benchAutoTrack(int n) {
+    int sonar = halGetSensor(ultrasonic);
+    for(int i = 0; i < n; i++) {
+        betterAutoTrack(robot, sonar);
+    }
+}
+
+static void benchSonarFiltered(int n) {
+    float sum = 0;
+    for(int i = 0; i < n; i++) {
+        sum += getUltraSonicFiltered(robot);
+    }
+    sink = sum;
+}
+
+/**
+ * Times a rate limited log call that is
+ * enabled, which is what a hot loop pays when
+ * built with debug logging. Most calls are
+ * suppressed by the rate limit.
+ */
+static void benchLogEvery(int n) {
+    for(int i = 0; i < n; i++) {
+        world.timeUs += 1000;
+        logRecord(robot.log, LOG_LEVEL_DEBUG, 250, LOG_RANGE, inputs[i & 255], 0, 0);
+    }
+    logInit(robot.log);
+}
+
+/**
+ * Times one approach plan with the beacon
+ * known and off to the left, so every
+ * candidate runs its full rollout.
+ */
+static void benchMPCPlan(int n) {
+    robot.beaconKnown = true;
+    robot.beaconX = 150;
+    robot.beaconY = 40;
+    robot.leftSpeed = 30;
+    robot.rightSpeed = 30;
+
+    float left = 0;
+    float right = 0;
+    for(int i = 0; i < n; i++) {
+        mpcPlan(robot, 127, left, right);
+    }
+    sink = left + right;
+}
+
+static void benchApproachStep(int n) {
+    bool wasRight = false;
+    for(int i = 0; i < n; i++) {
+        approachStep(robot, 127, wasRight);
+    }
+}
+
+static void benchApproachTick(int n) {
+    bool wasRight = false;
+    execInit(robot.exec, EXEC_PERIOD);
+
+    for(int i = 0; i < n; i++) {
+        approachStep(robot, 127, wasRight);
+        execTick(robot.exec, robot.log);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*body)(int n);
+    int iterations;
+} Benchmark;
+
+static const Benchmark BENCHMARKS[] = {
+    {"sign",                  benchSign,            1000000},
+    {"clamp",                 benchClamp,           1000000},
+    {"clamp2",                benchClamp2,          1000000},
+    {"PIDCalculate",          benchPIDNoSlew,       1000000},
+    {"PIDCalculate_slew",     benchPIDSlew,         1000000},
+    {"PIDFilter",             benchPIDFilterNoSlew, 1000000},
+    {"PIDFilter_slew",        benchPIDFilterSlew,   1000000},
+    {"halGetSensor",          benchHalRead,         200000},
+    {"getLeftLight",          benchLeftLight,       100000},
+    {"getRightLight",         benchRightLight,      100000},
+    {"betterAutoTrack",       benchAutoTrack,       50000},
+    {"getUltraSonicFiltered", benchSonarFiltered,   100000},
+    {"logRecordEvery",        benchLogEvery,        1000000},
+    {"mpcPlan",               benchMPCPlan,         20000},
+    {"approachStep",          benchApproachStep,    2000},
+    {"approachTick",          benchApproachTick,    2000},
+};
+
+const int BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+typedef struct {
+    char name[64];
+    double nsPerOp;
+    double allocsPerOp;
+
+    // The calibration loop's ns/op, measured
+    // alongside.
+    double calibrateNs;
+} BenchResult;
+
+/**
+ * Times one pass of the calibration loop.
+ *
+ * @return Its ns/op.
+ */
+static double runCalibrate() {
+    long long start = hostMonotonicMicros();
+    benchCalibrate(BENCH_CALIBRATE_ITERATIONS);
+    return (hostMonotonicMicros() - start) * 1000.0 / BENCH_CALIBRATE_ITERATIONS;
+}
+
+/**
+ * Runs one benchmark a few times from a fresh
+ * world and keeps the fastest run, which is
+ * the one least disturbed by the host. The
+ * calibration loop runs before each one and
+ * also keeps its fastest run.
+ */
+static BenchResult runBenchmark(const Benchmark &bench) {
+    BenchResult result;
+    strncpy(result.name, bench.name, sizeof(result.name) - 1);
+    result.name[sizeof(result.name) - 1] = 0;
+    result.nsPerOp = 1e30;
+    result.allocsPerOp = 0;
+    result.calibrateNs = 1e30;
+
+    for(int r = 0; r < BENCH_REPEATS; r++) {
+        double calibrate = runCalibrate();
+        if(calibrate < result.calibrateNs) {
+            result.calibrateNs = calibrate;
+        }
+
+        benchSetup();
+
+        long allocStart = allocations;
+        long long start = hostMonotonicMicros();
+
+        bench.body(bench.iterations);
+
+        double ns = (hostMonotonicMicros() - start) * 1000.0 / bench.iterations;
+        double allocs = (double)(allocations - allocStart) / bench.iterations;
+
+        if(ns < result.nsPerOp) {
+            result.nsPerOp = ns;
+        }
+        if(allocs > result.allocsPerOp) {
+            result.allocsPerOp = allocs;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Reads a baseline file. Each line is a
+ * benchmark name, ns/op, allocations/op and
+ * the calibration loop's ns/op.
+ *
+ * @return The number of entries read, or -1
+ * if the file couldn't be opened.
+ */
+static int readBaseline(const char *path, BenchResult *baseline) {
+    FILE *file = fopen(path, "r");
+    if(file == 0) {
+        return -1;
+    }
+
+    int count = 0;
+    while(count < BENCH_MAX_RESULTS
+          && fscanf(file, "%63s %lf %lf %lf", baseline[count].name, &baseline[count].nsPerOp,
+                    &baseline[count].allocsPerOp, &baseline[count].calibrateNs) == 4) {
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+static bool writeBaseline(const char *path, BenchResult *results, int count) {
+    FILE *file = fopen(path, "w");
+    if(file == 0) {
+        return false;
+    }
+
+    for(int i = 0; i < count; i++) {
+        fprintf(file, "%s %.2f %.3f %.3f\n", results[i].name, results[i].nsPerOp, results[i].allocsPerOp, results[i].calibrateNs);
+    }
+
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool write = argc > 2 && strcmp(argv[1], "-w") == 0;
+    const char *baselinePath = write ? argv[2] : argc > 1 ? argv[1] : 0;
+
+    BenchResult baseline[BENCH_MAX_RESULTS];
+    int baselineCount = 0;
+
+    if(baselinePath != 0 && !write) {
+        baselineCount = readBaseline(baselinePath, baseline);
+        if(baselineCount <= 0) {
+            fprintf(stderr, "can't read baseline %s\n", baselinePath);
+            return 2;
+        }
+    }
+
+    for(int i = 0; i < 256; i++) {
+        inputs[i] = (i * 37 % 256) - 128;
+    }
+
+    BenchResult results[BENCH_MAX_RESULTS];
+    int regressions = 0;
+
+    printf("%-24s %12s %10s %12s\n", "benchmark", "ns/op", "allocs/op", "expected");
+
+    for(int i = 0; i < BENCHMARK_COUNT; i++) {
+        results[i] = runBenchmark(BENCHMARKS[i]);
+        BenchResult &r = results[i];
+
+        printf("%-24s %12.2f %10.3f", r.name, r.nsPerOp, r.allocsPerOp);
+
+        for(int j = 0; j < baselineCount; j++) {
+            if(strcmp(baseline[j].name, r.name) != 0) {
+                continue;
+            }
+
+            // What the baseline would have taken with
+            // the host as fast as it is now.
+            double expected = baseline[j].nsPerOp * r.calibrateNs / baseline[j].calibrateNs;
+
+            bool slower = r.nsPerOp > expected * BENCH_TOLERANCE + BENCH_SLACK_NS;
+            bool allocates = r.allocsPerOp > baseline[j].allocsPerOp;
+
+            printf(" %12.2f%s%s", expected, slower ? "  SLOWER" : "", allocates ? "  ALLOCATES" : "");
+
+            if(slower || allocates) {
+                regressions++;
+            }
+        }
+        printf("\n");
+    }
+
+    Executive &exec = robot.exec;
+    printf("approachTick executive: %d ms ticks, %ld run, %d overruns, busy %ld us avg, %ld us max\n",
+        exec.period, exec.ticks, exec.overruns, exec.busyTotal / exec.ticks, exec.busyMax);
+
+    if(write) {
+        if(!writeBaseline(baselinePath, results, BENCHMARK_COUNT)) {
+            fprintf(stderr, "can't write baseline %s\n", baselinePath);
+            return 2;
+        }
+        printf("baseline written to %s\n", baselinePath);
+    }
+
+    if(regressions > 0) {
+        printf("%d regression(s)\n", regressions);
+        return 1;
+    }
+    return 0;
+}
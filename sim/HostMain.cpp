@@ -0,0 +1,154 @@
+//======================================
+// Host entry point. Compiles the robot
+// code from src/ against the simulator or
+// trace replay HAL backend and runs the
+// normal finite state machine.
+//
+//   g++ -std=c++11 -O2 -pthread -DHAL_SIM sim/HostMain.cpp sim/Simulator.cpp -o okarito_sim
+//   ./okarito_sim [-b millivolts] [-t prefix] [robotX robotY robotDeg beaconX beaconY]...
+//
+// Every group of five arguments is one scenario. Scenarios run in
+// parallel, one robot and one simulated world per thread. -b runs
+// every scenario on a battery at the given voltage. -t records each
+// scenario's sensors to prefix<N>.txt, in the replay backend's trace
+// format. Each result is preceded by the executive's tick statistics
+// for that robot.
+//
+//   g++ -std=c++11 -O2 -DHAL_REPLAY sim/HostMain.cpp sim/Replay.cpp -o okarito_replay
+//   ./okarito_replay trace.txt [motors.txt]
+//======================================
+
+#include "RobotC.h"
+
+#define main okaritoMain
+#include "../src/main.c"
+#undef main
+
+#if defined(HAL_SIM)
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+typedef struct {
+    SimWorld world;
+    Robot robot;
+} SimInstance;
+
+/**
+ * Runs one robot in its own simulated world.
+ * Each instance is bound to the thread that
+ * runs it, so instances can run in parallel.
+ */
+static void runInstance(SimInstance &instance) {
+    simBind(instance.world);
+
+    try {
+        runRobot(instance.robot);
+    }
+    catch(SimTimeout &) {
+        printf("timeout\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    float battery = 0;
+    const char *tracePrefix = 0;
+
+    while(argc > 2 && (strcmp(argv[1], "-b") == 0 || strcmp(argv[1], "-t") == 0)) {
+        if(argv[1][1] == 'b') {
+            battery = atof(argv[2]);
+        }
+        else {
+            tracePrefix = argv[2];
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    int count = argc > 1 ? (argc - 1) / 5 : 1;
+    std::vector<SimInstance> instances(count);
+
+    for(int i = 0; i < count; i++) {
+        SimWorld &world = instances[i].world;
+
+        if(argc > 1) {
+            char **arg = argv + 1 + i * 5;
+            simInit(world, atof(arg[0]), atof(arg[1]), atof(arg[2]), atof(arg[3]), atof(arg[4]));
+        }
+        else {
+            simInit(world, 115, 40, 90, 60, 180);
+        }
+        world.timeLimitUs = 30000000LL;
+
+        if(battery > 0) {
+            world.batteryMv = battery;
+        }
+
+        if(tracePrefix) {
+            char path[256];
+            snprintf(path, sizeof(path), "%s%d.txt", tracePrefix, i);
+            world.trace = fopen(path, "w");
+            if(!world.trace) {
+                fprintf(stderr, "can't write trace %s\n", path);
+                return 2;
+            }
+        }
+    }
+
+    long long wallStart = hostMonotonicMicros();
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < count; i++) {
+        threads.push_back(std::thread(runInstance, std::ref(instances[i])));
+    }
+    for(int i = 0; i < count; i++) {
+        threads[i].join();
+    }
+
+    printf("simulated %d robot(s) in %.3f s\n", count, (hostMonotonicMicros() - wallStart) / 1e6);
+
+    int failures = 0;
+    for(int i = 0; i < count; i++) {
+        SimWorld &world = instances[i].world;
+        Executive &exec = instances[i].robot.exec;
+
+        printf("exec: %ld ticks, %d overruns, busy %ld us max\n", exec.ticks, exec.overruns, exec.busyMax);
+
+        if(world.connections > 1) {
+            printf("connected %d times, last %.3f s\n", world.connections, (world.lastConnectTime - world.pressStart) / 1000.0);
+        }
+        else if(world.connections == 1) {
+            printf("connected %.3f s\n", (world.connectTime - world.pressStart) / 1000.0);
+        }
+        else {
+            printf("not connected, beacon %.1f cm away\n", simBeaconDistance(world));
+            failures++;
+        }
+
+        if(world.trace) {
+            fclose(world.trace);
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+#elif defined(HAL_REPLAY)
+
+int main(int argc, char **argv) {
+    if(argc < 2 || !replayOpen(argv[1], argc > 2 ? argv[2] : 0)) {
+        fprintf(stderr, "usage: %s trace.txt [motors.txt]\n", argv[0]);
+        return 1;
+    }
+
+    try {
+        okaritoMain();
+    }
+    catch(ReplayEnd &) {
+    }
+
+    replayClose();
+    return 0;
+}
+
+#endif
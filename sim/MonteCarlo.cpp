@@ -0,0 +1,226 @@
+//======================================
+// Monte Carlo fault benchmark. Runs the
+// normal finite state machine against the
+// simulator over a set of random scenarios,
+// once with clean sensors and once for each
+// fault class, and reports how much each
+// class slows the connection down.
+//
+//   g++ -std=c++11 -O2 -pthread -DHAL_SIM sim/MonteCarlo.cpp sim/Simulator.cpp -o okarito_mc
+//   ./okarito_mc [-n runs] [-s seed]
+//
+// The scenarios and the fault schedules both
+// come from the seed, so a run can be
+// repeated exactly. Every class sees the same
+// scenarios, and the slowdown is taken per
+// scenario against the clean run.
+//======================================
+
+#include "RobotC.h"
+
+// The robot's debug stream would swamp the
+// report, so it is dropped here.
+#undef writeDebugStream
+#undef writeDebugStreamLine
+#define writeDebugStream(...)     (0 && printf(__VA_ARGS__))
+#define writeDebugStreamLine(...) (0 && printf(__VA_ARGS__))
+
+#define main okaritoMain
+#include "../src/main.c"
+#undef main
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+const int   MC_DEFAULT_RUNS     = 64;
+const float MC_TIME_LIMIT       = 30;        // s per scenario
+const float MC_ARENA            = 230;       // cm, the simulator's arena
+const float MC_ARENA_MARGIN     = 25;        // cm from the walls
+const float MC_MIN_SEPARATION   = 60;        // cm between the robot and the beacon
+
+// Event rate (1/s) and mean length (ms) of each
+// fault class, in SimFaultClass order.
+const float MC_FAULT_RATE[SIM_FAULT_COUNT]     = {2.0, 0.5, 1.0, 2.0, 0.2};
+const float MC_FAULT_DURATION[SIM_FAULT_COUNT] = {60,  100, 10,  5,   1000};
+
+typedef struct {
+    float x, y, theta;
+    float beaconX, beaconY;
+} Scenario;
+
+typedef struct {
+    SimWorld world;
+    Robot robot;
+    bool timedOut;
+} Trial;
+
+/**
+ * Same xorshift32 as the fault schedules, so
+ * the scenarios don't depend on the host's
+ * rand().
+ */
+static float mcRandom(unsigned int &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) / 16777216.0f;
+}
+
+static std::vector<Scenario> makeScenarios(int count, unsigned int seed) {
+    std::vector<Scenario> scenarios(count);
+    unsigned int state = seed * 2654435761u + 1;
+    float span = MC_ARENA - 2 * MC_ARENA_MARGIN;
+
+    for(int i = 0; i < count; i++) {
+        Scenario &s = scenarios[i];
+
+        do {
+            s.x = MC_ARENA_MARGIN + mcRandom(state) * span;
+            s.y = MC_ARENA_MARGIN + mcRandom(state) * span;
+            s.beaconX = MC_ARENA_MARGIN + mcRandom(state) * span;
+            s.beaconY = MC_ARENA_MARGIN + mcRandom(state) * span;
+        } while(hypot(s.beaconX - s.x, s.beaconY - s.y) < MC_MIN_SEPARATION);
+
+        s.theta = mcRandom(state) * 360;
+    }
+    return scenarios;
+}
+
+static void runTrial(Trial &trial) {
+    simBind(trial.world);
+    trial.timedOut = false;
+
+    try {
+        runRobot(trial.robot);
+    }
+    catch(SimTimeout &) {
+        trial.timedOut = true;
+    }
+}
+
+/**
+ * Runs every scenario with one fault class
+ * enabled (or none, for -1) and returns the
+ * connection time of each, or -1 where the
+ * robot didn't connect.
+ */
+static std::vector<float> runClass(const std::vector<Scenario> &scenarios, int fault, unsigned int seed, int &falseDetaches) {
+    int count = scenarios.size();
+    std::vector<Trial> trials(count);
+    std::vector<float> times(count);
+
+    for(int i = 0; i < count; i++) {
+        const Scenario &s = scenarios[i];
+        SimWorld &world = trials[i].world;
+
+        simInit(world, s.x, s.y, s.theta, s.beaconX, s.beaconY);
+        world.timeLimitUs = (long long)(MC_TIME_LIMIT * 1e6);
+
+        simFaultsInit(world, seed + i);
+        if(fault >= 0) {
+            simFaultEnable(world, fault, MC_FAULT_RATE[fault], MC_FAULT_DURATION[fault]);
+        }
+    }
+
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int w = 0; w < workers; w++) {
+        threads.push_back(std::thread([&]() {
+            for(int i = next++; i < count; i = next++) {
+                runTrial(trials[i]);
+            }
+        }));
+    }
+    for(int w = 0; w < workers; w++) {
+        threads[w].join();
+    }
+
+    falseDetaches = 0;
+    for(int i = 0; i < count; i++) {
+        SimWorld &world = trials[i].world;
+
+        if(world.connections > 0) {
+            times[i] = (world.connectTime - world.pressStart) / 1000.0;
+        }
+        else {
+            times[i] = -1;
+
+            // The robot thought it was done.
+            if(!trials[i].timedOut) {
+                falseDetaches++;
+            }
+        }
+    }
+    return times;
+}
+
+int main(int argc, char **argv) {
+    int runs = MC_DEFAULT_RUNS;
+    unsigned int seed = 1;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], 0, 10);
+        }
+        else {
+            fprintf(stderr, "usage: %s [-n runs] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Scenario> scenarios = makeScenarios(runs, seed);
+    std::vector<float> clean;
+    long long wallStart = hostMonotonicMicros();
+
+    printf("%-18s %7s %8s %8s %10s %8s\n", "fault", "ok", "mean s", "p90 s", "slowdown s", "false");
+
+    for(int fault = -1; fault < SIM_FAULT_COUNT; fault++) {
+        int falseDetaches;
+        std::vector<float> times = runClass(scenarios, fault, seed, falseDetaches);
+
+        if(fault < 0) {
+            clean = times;
+        }
+
+        // Slowdown is only taken over scenarios that
+        // connected both clean and with the fault.
+        std::vector<float> ok;
+        float total = 0;
+        float slowdown = 0;
+        int paired = 0;
+
+        for(int i = 0; i < runs; i++) {
+            if(times[i] < 0) {
+                continue;
+            }
+            ok.push_back(times[i]);
+            total += times[i];
+
+            if(clean[i] >= 0) {
+                slowdown += times[i] - clean[i];
+                paired++;
+            }
+        }
+
+        std::sort(ok.begin(), ok.end());
+        int n = ok.size();
+
+        printf("%-18s %3d/%-3d %8.2f %8.2f %10.2f %8d\n",
+            fault < 0 ? "clean" : simFaultName(fault), n, runs,
+            n > 0 ? total / n : 0.0f,
+            n > 0 ? ok[std::min(n - 1, (int)(n * 0.9))] : 0.0f,
+            paired > 0 ? slowdown / paired : 0.0f,
+            falseDetaches);
+    }
+
+    printf("simulated %d robot(s) in %.3f s\n", runs * (SIM_FAULT_COUNT + 1), (hostMonotonicMicros() - wallStart) / 1e6);
+    return 0;
+}
@@ -0,0 +1,793 @@
+//======================================
+// Sensor noise characterization. Streams
+// one or more recorded traces (the format is
+// in Replay.h) and measures how noisy each
+// sensor is: noise spectra, noise against
+// range and sonar dropouts. From that it
+// recommends the filter settings that are
+// otherwise picked by hand, and writes them
+// as a header.
+//
+//   g++ -std=c++11 -O2 sim/NoiseTool.cpp -o okarito_noise
+//   ./okarito_noise [-o SensorNoise.h] trace.txt...
+//
+// Traces are read one line at a time and
+// every statistic is a running one, so
+// captures of any length use the same few
+// kB. A gap in the timestamps (or the start
+// of the next file) breaks the differences
+// and spectra rather than smearing them.
+//
+// Noise is measured from second differences,
+// which a signal moving at a steady rate
+// doesn't show up in. For white noise of
+// variance R they have variance 6R.
+//
+// The traces are also read a second time to
+// fit the beacon's brightness against the
+// sonar range, the same line
+// src/LightRange.c refits on the robot, from
+// the ambient level the first pass found.
+//======================================
+
+#include "RobotC.h"
+#include "../src/Constants.h"
+
+#include <cmath>
+#include <cstring>
+
+// Samples further apart than this are
+// treated as separate segments.
+const long NOISE_MAX_GAP_MS = 100;
+
+// Spectra are averaged over blocks of this
+// many samples (a power of two).
+const int NOISE_FFT_SIZE = 64;
+const int NOISE_BANDS = 8;
+
+// Noise against range is binned by the
+// sonar reading.
+const float NOISE_RANGE_BIN = 20;      // cm
+const int NOISE_RANGE_BINS = 8;
+
+// Sonar rate of change histogram, for the
+// slew limit.
+const float NOISE_RATE_BIN = 0.02;     // cm/ms
+const int NOISE_RATE_BINS = 250;
+const float NOISE_RATE_PERCENTILE = 0.99;
+const float NOISE_SLEW_MARGIN = 1.25;
+
+// Histogram of the sonar's second differences
+// while moving, for the process noise. Range
+// jumps (a new target coming into the cone)
+// would swamp a plain variance.
+const float NOISE_SECOND_BIN = 0.1;    // cm
+const int NOISE_SECOND_BINS = 500;
+
+// Light readings histogram, for the
+// ambient level.
+const int NOISE_LEVEL_BIN = 16;
+const int NOISE_LEVEL_BINS = 4096 / NOISE_LEVEL_BIN;
+
+// How far the beacon thresholds should sit
+// from the noise, in standard deviations.
+const float NOISE_THRESH_SIGMAS = 6;
+
+// The beacon light filter should bring the
+// noise down to this fraction of the gap
+// between the found and lost thresholds.
+const float NOISE_LIGHT_TARGET = 0.05;
+const int NOISE_MAX_AVERAGES = 8;
+
+// Fewer samples than this and a statistic
+// isn't reported.
+const long NOISE_MIN_SAMPLES = 50;
+
+//======================================
+// Running statistics
+//======================================
+
+typedef struct {
+    long long n;
+    double mean, m2;
+} Running;
+
+static void runningAdd(Running &r, double x) {
+    r.n++;
+    double delta = x - r.mean;
+    r.mean += delta / r.n;
+    r.m2 += delta * (x - r.mean);
+}
+
+static double runningVar(const Running &r) {
+    return r.n > 1 ? r.m2 / (r.n - 1) : 0;
+}
+
+//======================================
+// Spectra
+//======================================
+
+/**
+ * In-place radix-2 FFT of NOISE_FFT_SIZE
+ * points.
+ */
+static void fft(double *re, double *im) {
+    int n = NOISE_FFT_SIZE;
+
+    for(int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for(; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if(i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for(int len = 2; len <= n; len <<= 1) {
+        double angle = -2 * M_PI / len;
+        for(int i = 0; i < n; i += len) {
+            for(int k = 0; k < len / 2; k++) {
+                double wr = cos(angle * k);
+                double wi = sin(angle * k);
+                double xr = re[i + k + len / 2] * wr - im[i + k + len / 2] * wi;
+                double xi = re[i + k + len / 2] * wi + im[i + k + len / 2] * wr;
+                re[i + k + len / 2] = re[i + k] - xr;
+                im[i + k + len / 2] = im[i + k] - xi;
+                re[i + k] += xr;
+                im[i + k] += xi;
+            }
+        }
+    }
+}
+
+//======================================
+// Channels
+//======================================
+
+typedef struct {
+    const char *name;
+    const char *units;
+    bool canDrop;
+
+    long long samples;
+    long long dropouts;
+    long long dropoutRuns;
+    long run, longestRun;
+    long dropStart;
+    long longestDropMs;
+
+    Running value;
+    Running second;
+    Running secondStill;
+    Running rangeSecond[NOISE_RANGE_BINS];
+
+    // The last three good samples, newest first.
+    double last[3];
+    long lastTime[3];
+    int history;
+
+    double block[NOISE_FFT_SIZE];
+    int blockSize;
+    double power[NOISE_FFT_SIZE / 2 + 1];
+    long long blocks;
+} Channel;
+
+enum {
+    CH_LEFT_LIGHT,
+    CH_RIGHT_LIGHT,
+    CH_CABLE_LIGHT,
+    CH_SONAR,
+    CH_POT,
+    CH_LEFT_ENC,
+    CH_RIGHT_ENC,
+    CHANNEL_COUNT
+};
+
+static Channel channels[CHANNEL_COUNT];
+
+static long long sonarRates[NOISE_RATE_BINS];
+static long long sonarSeconds[NOISE_SECOND_BINS];
+static long long lightLevels[NOISE_LEVEL_BINS];
+static long long totalSamples = 0;
+static long long gaps = 0;
+static double sampleTime = 0;
+static long long sampleIntervals = 0;
+static int traces = 0;
+
+static void channelInit(Channel &c, const char *name, const char *units, bool canDrop) {
+    memset(&c, 0, sizeof(c));
+    c.name = name;
+    c.units = units;
+    c.canDrop = canDrop;
+}
+
+/**
+ * Starts a new segment: differences and
+ * spectrum blocks never span a gap.
+ */
+static void channelBreak(Channel &c) {
+    c.history = 0;
+    c.blockSize = 0;
+}
+
+/**
+ * Detrends and windows a full block, and
+ * adds its power spectrum to the channel's.
+ */
+static void channelSpectrum(Channel &c) {
+    double re[NOISE_FFT_SIZE];
+    double im[NOISE_FFT_SIZE];
+    int n = NOISE_FFT_SIZE;
+
+    // Least squares line through the block, so
+    // slow motion doesn't leak into every bin.
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for(int i = 0; i < n; i++) {
+        sx += i;
+        sy += c.block[i];
+        sxx += (double)i * i;
+        sxy += i * c.block[i];
+    }
+    double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    double offset = (sy - slope * sx) / n;
+
+    for(int i = 0; i < n; i++) {
+        double hann = 0.5 - 0.5 * cos(2 * M_PI * i / (n - 1));
+        re[i] = (c.block[i] - offset - slope * i) * hann;
+        im[i] = 0;
+    }
+
+    fft(re, im);
+
+    for(int k = 0; k <= n / 2; k++) {
+        c.power[k] += re[k] * re[k] + im[k] * im[k];
+    }
+    c.blocks++;
+    c.blockSize = 0;
+}
+
+/**
+ * Adds one reading to a channel.
+ *
+ * @param still Whether the drivetrain hasn't
+ * moved over the last two samples.
+ * @param range The sonar range at this sample,
+ * or -1 if it dropped out.
+ */
+static void channelAdd(Channel &c, long time, double x, bool still, double range) {
+    c.samples++;
+
+    if(c.canDrop && x < 0) {
+        if(c.run == 0) {
+            c.dropoutRuns++;
+            c.dropStart = time;
+        }
+        c.dropouts++;
+        c.run++;
+        if(c.run > c.longestRun) {
+            c.longestRun = c.run;
+        }
+        if(time - c.dropStart > c.longestDropMs) {
+            c.longestDropMs = time - c.dropStart;
+        }
+        channelBreak(c);
+        return;
+    }
+    c.run = 0;
+
+    runningAdd(c.value, x);
+
+    c.last[2] = c.last[1];
+    c.last[1] = c.last[0];
+    c.last[0] = x;
+    c.lastTime[2] = c.lastTime[1];
+    c.lastTime[1] = c.lastTime[0];
+    c.lastTime[0] = time;
+    if(c.history < 3) {
+        c.history++;
+    }
+
+    if(c.history == 3) {
+        double d2 = c.last[0] - 2 * c.last[1] + c.last[2];
+        runningAdd(c.second, d2);
+
+        if(still) {
+            runningAdd(c.secondStill, d2);
+        }
+        else if(&c == &channels[CH_SONAR]) {
+            int bin = (int)(fabs(d2) / NOISE_SECOND_BIN);
+            sonarSeconds[bin < NOISE_SECOND_BINS ? bin : NOISE_SECOND_BINS - 1]++;
+        }
+
+        int bin = (int)(range / NOISE_RANGE_BIN);
+        if(range >= 0 && bin < NOISE_RANGE_BINS) {
+            runningAdd(c.rangeSecond[bin], d2);
+        }
+    }
+
+    c.block[c.blockSize++] = x;
+    if(c.blockSize == NOISE_FFT_SIZE) {
+        channelSpectrum(c);
+    }
+}
+
+/**
+ * Gets the channel's white noise variance.
+ * Readings taken while the robot sat still
+ * are preferred when there are enough.
+ */
+static double channelNoise(const Channel &c) {
+    if(c.secondStill.n >= NOISE_MIN_SAMPLES) {
+        return runningVar(c.secondStill) / 6;
+    }
+    return runningVar(c.second) / 6;
+}
+
+//======================================
+// Trace reading
+//======================================
+
+typedef struct {
+    long time;
+    int sensors[HOST_SENSOR_COUNT];
+    long encoders[2];
+} TraceSample;
+
+static bool readSample(FILE *file, TraceSample &s) {
+    char line[512];
+
+    while(fgets(line, sizeof(line), file)) {
+        if(line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        char *cursor = line;
+        s.time = strtol(cursor, &cursor, 10);
+        for(int i = 0; i < HOST_SENSOR_COUNT; i++) {
+            s.sensors[i] = (int)strtol(cursor, &cursor, 10);
+        }
+        s.encoders[0] = strtol(cursor, &cursor, 10);
+        s.encoders[1] = strtol(cursor, &cursor, 10);
+        return true;
+    }
+    return false;
+}
+
+static bool readTrace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if(file == 0) {
+        return false;
+    }
+    traces++;
+
+    TraceSample s, previous;
+    bool hasPrevious = false;
+    int stillRun = 0;
+
+    while(readSample(file, s)) {
+        totalSamples++;
+
+        long dt = hasPrevious ? s.time - previous.time : 0;
+
+        if(!hasPrevious || dt <= 0 || dt > NOISE_MAX_GAP_MS) {
+            if(hasPrevious) {
+                gaps++;
+            }
+            for(int i = 0; i < CHANNEL_COUNT; i++) {
+                channelBreak(channels[i]);
+            }
+        }
+        else {
+            sampleTime += dt;
+            sampleIntervals++;
+
+            int prevRange = previous.sensors[ultrasonic];
+            int range = s.sensors[ultrasonic];
+            if(prevRange >= 0 && range >= 0) {
+                int bin = (int)(fabs((double)(range - prevRange)) / dt / NOISE_RATE_BIN);
+                sonarRates[bin < NOISE_RATE_BINS ? bin : NOISE_RATE_BINS - 1]++;
+            }
+        }
+
+        // A second difference spans two intervals, so
+        // both have to be still.
+        bool moved = !hasPrevious
+                  || s.encoders[0] != previous.encoders[0]
+                  || s.encoders[1] != previous.encoders[1];
+        stillRun = moved ? 0 : stillRun + 1;
+        bool still = stillRun >= 2;
+        double range = s.sensors[ultrasonic];
+
+        channelAdd(channels[CH_LEFT_LIGHT], s.time, s.sensors[lightSensor2], still, range);
+        channelAdd(channels[CH_RIGHT_LIGHT], s.time, s.sensors[rightLightSensor], still, range);
+        channelAdd(channels[CH_CABLE_LIGHT], s.time, s.sensors[lightSensor], still, range);
+        channelAdd(channels[CH_SONAR], s.time, s.sensors[ultrasonic], still, range);
+        channelAdd(channels[CH_POT], s.time, s.sensors[towerPot], still, range);
+        channelAdd(channels[CH_LEFT_ENC], s.time, s.encoders[0], still, range);
+        channelAdd(channels[CH_RIGHT_ENC], s.time, s.encoders[1], still, range);
+
+        for(int i = 0; i < 2; i++) {
+            int level = (i == 0 ? s.sensors[lightSensor2] : s.sensors[rightLightSensor]) / NOISE_LEVEL_BIN;
+            if(level >= 0 && level < NOISE_LEVEL_BINS) {
+                lightLevels[level]++;
+            }
+        }
+
+        previous = s;
+        hasPrevious = true;
+    }
+
+    fclose(file);
+    return true;
+}
+
+//======================================
+// Light range fit
+//======================================
+
+// Least squares sums for the line
+// src/LightRange.c fits on the robot.
+typedef struct {
+    double n, sx, sy, sxx, sxy;
+    double a, b;
+} LightFit;
+
+static LightFit lightFit;
+
+/**
+ * The tower angle a pot reading stands for,
+ * converted the same way as the robot's
+ * potToDegrees().
+ */
+static double potDegrees(double pot) {
+    return (pot - POT_ZERO) / TICKS_PER_DEG;
+}
+
+/**
+ * Whether a raw sonar reading is a real range,
+ * by the same test as the robot's
+ * sonarValid().
+ */
+static bool sonarValid(int raw) {
+    return raw > 0 && raw < GRID_SONAR_MAX;
+}
+
+/**
+ * Solves the sums for the line. Leaves the
+ * line as it was if the sums don't pin one
+ * down.
+ */
+static void lightFitSolve(LightFit &f) {
+    double det = f.n * f.sxx - f.sx * f.sx;
+    if(f.n < 2 || det <= 0) {
+        return;
+    }
+    f.b = (f.n * f.sxy - f.sx * f.sy) / det;
+    f.a = (f.sy - f.b * f.sx) / f.n;
+}
+
+/**
+ * Adds a trace's (light, sonar) pairs to the
+ * fit, picked the way getBeaconRange() picks
+ * them on the robot: the sonar in range and
+ * the tower inside its cone, and one of the
+ * averaged beacon sensors over
+ * BEACON_FOUND_THRESH. Needs the ambient
+ * level, so it runs as a second pass once the
+ * light histogram is complete.
+ *
+ * @param reject Whether to drop pairs further
+ * than LIGHT_CAL_REJECT off the line already
+ * in the fit, as the robot does.
+ */
+static bool fitTrace(const char *path, double ambient, LightFit &fit, const LightFit &line, bool reject) {
+    FILE *file = fopen(path, "r");
+    if(file == 0) {
+        return false;
+    }
+
+    TraceSample s;
+    int left[LIGHT_AVERAGES];
+    int right[LIGHT_AVERAGES];
+    int history = 0;
+    long lastTime = 0;
+
+    while(readSample(file, s)) {
+        if(history > 0 && (s.time - lastTime <= 0 || s.time - lastTime > NOISE_MAX_GAP_MS)) {
+            history = 0;
+        }
+        lastTime = s.time;
+
+        for(int i = LIGHT_AVERAGES - 1; i > 0; i--) {
+            left[i] = left[i - 1];
+            right[i] = right[i - 1];
+        }
+        left[0] = s.sensors[lightSensor2];
+        right[0] = s.sensors[rightLightSensor];
+        if(history < LIGHT_AVERAGES) {
+            history++;
+            continue;
+        }
+
+        double l = 0, r = 0;
+        for(int i = 0; i < LIGHT_AVERAGES; i++) {
+            l += left[i];
+            r += right[i];
+        }
+        l /= LIGHT_AVERAGES;
+        r /= LIGHT_AVERAGES;
+        double light = (l + r) / 2;
+
+        int sonar = s.sensors[ultrasonic];
+        bool onBeacon = l > BEACON_FOUND_THRESH || r > BEACON_FOUND_THRESH;
+        bool inCone = fabs(potDegrees(s.sensors[towerPot]) - 180) < SONAR_CONE;
+        if(!sonarValid(sonar) || !onBeacon || !inCone || light - ambient < LIGHT_RANGE_MIN) {
+            continue;
+        }
+
+        double d = (sonar + SONAR_OFFSET) / 100;
+        double x = d * d;
+        double y = 1000 / (light - ambient);
+
+        if(reject) {
+            double expected = line.a + line.b * x;
+            if(fabs(y - expected) > LIGHT_CAL_REJECT * expected) {
+                continue;
+            }
+        }
+
+        fit.n++;
+        fit.sx += x;
+        fit.sy += y;
+        fit.sxx += x * x;
+        fit.sxy += x * y;
+    }
+
+    fclose(file);
+    return true;
+}
+
+/**
+ * Fits the light range line over every trace:
+ * once over all the pairs, then again without
+ * the pairs that fit is far off.
+ */
+static bool fitLightRange(char **paths, int count, double ambient) {
+    LightFit first;
+    memset(&first, 0, sizeof(first));
+    first.a = LIGHT_RANGE_A;
+    first.b = LIGHT_RANGE_B;
+
+    for(int i = 0; i < count; i++) {
+        if(!fitTrace(paths[i], ambient, first, first, false)) {
+            return false;
+        }
+    }
+    lightFitSolve(first);
+
+    memset(&lightFit, 0, sizeof(lightFit));
+    lightFit.a = first.a;
+    lightFit.b = first.b;
+
+    for(int i = 0; i < count; i++) {
+        if(!fitTrace(paths[i], ambient, lightFit, first, true)) {
+            return false;
+        }
+    }
+    lightFitSolve(lightFit);
+    return true;
+}
+
+//======================================
+// Report
+//======================================
+
+static double histogramPercentile(const long long *bins, int count, double binWidth, double fraction) {
+    long long total = 0;
+    for(int i = 0; i < count; i++) {
+        total += bins[i];
+    }
+    if(total == 0) {
+        return 0;
+    }
+
+    long long seen = 0;
+    for(int i = 0; i < count; i++) {
+        seen += bins[i];
+        if(seen >= fraction * total) {
+            return (i + 0.5) * binWidth;
+        }
+    }
+    return count * binWidth;
+}
+
+static void printChannel(const Channel &c, double dtMs) {
+    printf("%s (%s)\n", c.name, c.units);
+    printf("  samples %lld, mean %.1f, std %.2f, noise std %.2f (%.2f while still)\n",
+        c.value.n, c.value.mean, sqrt(runningVar(c.value)),
+        sqrt(runningVar(c.second) / 6), sqrt(runningVar(c.secondStill) / 6));
+
+    if(c.canDrop) {
+        printf("  dropouts %lld (%.2f%%) in %lld runs, longest %ld samples, %ld ms\n",
+            c.dropouts, c.samples ? 100.0 * c.dropouts / c.samples : 0, c.dropoutRuns, c.longestRun, c.longestDropMs);
+    }
+
+    if(c.blocks > 0 && dtMs > 0) {
+        // Split the spectrum into equal bands up to
+        // the Nyquist rate, as noise std per band.
+        double nyquist = 500.0 / dtMs;
+        int perBand = (NOISE_FFT_SIZE / 2) / NOISE_BANDS;
+        printf("  spectrum, %lld blocks:", c.blocks);
+        for(int b = 0; b < NOISE_BANDS; b++) {
+            double sum = 0;
+            for(int k = 1 + b * perBand; k <= (b + 1) * perBand; k++) {
+                sum += c.power[k];
+            }
+            printf(" %.0f-%.0fHz %.2f", nyquist * b / NOISE_BANDS, nyquist * (b + 1) / NOISE_BANDS,
+                sqrt(sum / c.blocks) / NOISE_FFT_SIZE * 2);
+        }
+        printf("\n");
+    }
+
+    printf("  noise std by range:");
+    for(int b = 0; b < NOISE_RANGE_BINS; b++) {
+        if(c.rangeSecond[b].n >= NOISE_MIN_SAMPLES) {
+            printf(" %.0f-%.0fcm %.2f", b * NOISE_RANGE_BIN, (b + 1) * NOISE_RANGE_BIN, sqrt(runningVar(c.rangeSecond[b]) / 6));
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * Writes one constant in the same columns as
+ * src/Constants.h.
+ */
+static void emitConstant(FILE *out, const char *type, const char *name, const char *value, const char *comment) {
+    char assigned[32];
+    snprintf(assigned, sizeof(assigned), "%s;", value);
+    fprintf(out, "const %-5s %-23s = %-13s // %s\n", type, name, assigned, comment);
+}
+
+static void emitInt(FILE *out, const char *name, long value, const char *comment) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    emitConstant(out, "int", name, text, comment);
+}
+
+static void emitFloat(FILE *out, const char *name, double value, int decimals, const char *comment) {
+    char text[24];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    emitConstant(out, "float", name, text, comment);
+}
+
+/**
+ * The ambient light level: the 10th
+ * percentile of the beacon sensors, which
+ * spend most of their time looking away from
+ * the beacon.
+ */
+static double lightAmbient() {
+    return histogramPercentile(lightLevels, NOISE_LEVEL_BINS, NOISE_LEVEL_BIN, 0.1);
+}
+
+static bool writeHeader(const char *path, double dtMs) {
+    FILE *out = fopen(path, "w");
+    if(out == 0) {
+        return false;
+    }
+
+    // Beacon sensors: enough averaging to bring the
+    // noise under a fraction of the threshold gap.
+    double lightNoise = sqrt(fmax(channelNoise(channels[CH_LEFT_LIGHT]), channelNoise(channels[CH_RIGHT_LIGHT])));
+    double target = NOISE_LIGHT_TARGET * (BEACON_FOUND_THRESH - BEACON_LOST_THRESH);
+    int averages = (int)ceil(lightNoise * lightNoise / (target * target));
+    averages = averages < 1 ? 1 : averages > NOISE_MAX_AVERAGES ? NOISE_MAX_AVERAGES : averages;
+
+    double ambient = lightAmbient();
+    double lostMin = ambient + NOISE_THRESH_SIGMAS * lightNoise / sqrt((double)averages);
+
+    double cableMin = NOISE_THRESH_SIGMAS * sqrt(channelNoise(channels[CH_CABLE_LIGHT]));
+
+    // Slew limit: the fastest the range really
+    // changes, with some margin.
+    double slew = histogramPercentile(sonarRates, NOISE_RATE_BINS, NOISE_RATE_BIN, NOISE_RATE_PERCENTILE) * NOISE_SLEW_MARGIN;
+
+    // Kalman covariances for a constant velocity
+    // model stepped once per sample: the
+    // measurement noise is the still noise, and
+    // whatever second difference is left over
+    // while moving is acceleration. The moving
+    // spread is taken from the 68th percentile,
+    // which is one standard deviation for
+    // Gaussian noise and ignores range jumps.
+    const Channel &sonar = channels[CH_SONAR];
+    double sonarR = channelNoise(sonar);
+    double moving = histogramPercentile(sonarSeconds, NOISE_SECOND_BINS, NOISE_SECOND_BIN, 0.683);
+    double sonarQ = fmax(0, moving * moving - 6 * sonarR);
+    double potR = channelNoise(channels[CH_POT]);
+
+    double hours = totalSamples * dtMs / 3600000;
+
+    fprintf(out, "// Generated by sim/NoiseTool.cpp from %lld samples (%.2f h, %.1f ms\n", totalSamples, hours, dtMs);
+    fprintf(out, "// apart) in %d trace(s). Review before copying the\n", traces);
+    fprintf(out, "// values into the constants named in the comments.\n\n");
+    fprintf(out, "#ifndef SENSORNOISE_H\n#define SENSORNOISE_H\n\n");
+    fprintf(out, "// Type            Name                    Value         Units\n");
+    emitFloat(out, "NOISE_SAMPLE_MS", dtMs, 1, "ms between samples");
+    emitInt(out, "NOISE_LIGHT_AVERAGES", averages, "samples (LIGHT_AVERAGES)");
+    emitFloat(out, "NOISE_LIGHT_STD", lightNoise, 2, "raw, per sample");
+    emitFloat(out, "NOISE_LIGHT_AMBIENT", ambient, 0, "raw (LIGHT_AMBIENT)");
+    emitFloat(out, "NOISE_LIGHT_RANGE_A", lightFit.a, 3, "1000/light (LIGHT_RANGE_A)");
+    emitFloat(out, "NOISE_LIGHT_RANGE_B", lightFit.b, 4, "per m^2 (LIGHT_RANGE_B)");
+    emitInt(out, "NOISE_LIGHT_RANGE_PAIRS", (long)lightFit.n, "pairs in the fit");
+    emitFloat(out, "NOISE_BEACON_LOST_MIN", lostMin, 0, "raw (BEACON_LOST_THRESH)");
+    emitFloat(out, "NOISE_CABLE_DELTA_MIN", cableMin, 0, "raw (CABLE_SENSOR_DELTA)");
+    emitFloat(out, "NOISE_ULTRASONIC_SLEW", slew, 2, "cm/ms (ULTRASONIC_SLEW)");
+    emitFloat(out, "NOISE_SONAR_DROPOUTS", sonar.samples ? (double)sonar.dropouts / sonar.samples : 0, 4, "fraction of readings");
+    emitInt(out, "NOISE_SONAR_DROPOUT_MS", sonar.longestDropMs, "ms, longest");
+    emitFloat(out, "NOISE_SONAR_KF_R", sonarR, 3, "cm^2");
+    emitFloat(out, "NOISE_SONAR_KF_Q", sonarQ, 3, "cm^2 per sample");
+    emitFloat(out, "NOISE_POT_KF_R", potR, 3, "ticks^2");
+    fprintf(out, "\n#endif\n");
+
+    fclose(out);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *headerPath = "SensorNoise.h";
+    int first = 1;
+
+    if(argc > 2 && strcmp(argv[1], "-o") == 0) {
+        headerPath = argv[2];
+        first = 3;
+    }
+
+    if(first >= argc) {
+        fprintf(stderr, "usage: %s [-o header] trace.txt...\n", argv[0]);
+        return 2;
+    }
+
+    channelInit(channels[CH_LEFT_LIGHT], "lightSensor2", "raw", false);
+    channelInit(channels[CH_RIGHT_LIGHT], "rightLightSensor", "raw", false);
+    channelInit(channels[CH_CABLE_LIGHT], "lightSensor", "raw", false);
+    channelInit(channels[CH_SONAR], "ultrasonic", "cm", true);
+    channelInit(channels[CH_POT], "towerPot", "ticks", false);
+    channelInit(channels[CH_LEFT_ENC], "left encoder", "ticks", false);
+    channelInit(channels[CH_RIGHT_ENC], "right encoder", "ticks", false);
+
+    for(int i = first; i < argc; i++) {
+        if(!readTrace(argv[i])) {
+            fprintf(stderr, "can't read trace %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if(sampleIntervals == 0) {
+        fprintf(stderr, "no usable samples\n");
+        return 2;
+    }
+
+    double dtMs = sampleTime / sampleIntervals;
+    printf("%lld samples, %.1f ms apart, %lld gaps\n\n", totalSamples, dtMs, gaps);
+
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        printChannel(channels[i], dtMs);
+    }
+
+    if(!fitLightRange(argv + first, argc - first, lightAmbient())) {
+        fprintf(stderr, "can't reread the traces for the light range fit\n");
+        return 2;
+    }
+    printf("light range: a %.3f, b %.4f from %.0f pairs, ambient %.0f\n", lightFit.a, lightFit.b, lightFit.n, lightAmbient());
+
+    if(!writeHeader(headerPath, dtMs)) {
+        fprintf(stderr, "can't write %s\n", headerPath);
+        return 2;
+    }
+    printf("\nrecommendations written to %s\n", headerPath);
+    return 0;
+}
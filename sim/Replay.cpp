@@ -0,0 +1,147 @@
+//======================================
+// Trace replay backend. See Replay.h for
+// the trace format.
+//======================================
+
+#include "Replay.h"
+
+const int REPLAY_READ_COST_US = 20;     // us
+const int REPLAY_BATTERY_MV   = 7800;   // mV
+
+typedef struct {
+    long time;
+    int sensors[HOST_SENSOR_COUNT];
+    long encoders[2];
+} ReplaySample;
+
+static FILE *trace = 0;
+static FILE *output = 0;
+static ReplaySample sample;
+static ReplaySample next;
+static bool hasNext = false;
+static long long timeUs = 0;
+static long encoderOffset[2];
+static int motors[HOST_MOTOR_COUNT];
+static int written[HOST_SENSOR_COUNT];
+
+/**
+ * Reads the next sample line from the trace.
+ *
+ * @return Whether a sample was read.
+ */
+static bool readSample(ReplaySample &s) {
+    char line[512];
+
+    while(fgets(line, sizeof(line), trace)) {
+        if(line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        char *cursor = line;
+        s.time = strtol(cursor, &cursor, 10);
+        for(int i = 0; i < HOST_SENSOR_COUNT; i++) {
+            s.sensors[i] = (int)strtol(cursor, &cursor, 10);
+        }
+        s.encoders[0] = strtol(cursor, &cursor, 10);
+        s.encoders[1] = strtol(cursor, &cursor, 10);
+        return true;
+    }
+    return false;
+}
+
+static void advance(long long us) {
+    timeUs += us;
+
+    while(hasNext && next.time * 1000 <= timeUs) {
+        sample = next;
+        hasNext = readSample(next);
+    }
+
+    if(!hasNext && sample.time * 1000 < timeUs - 1000000) {
+        throw ReplayEnd();
+    }
+}
+
+static int encoderIndex(int port) {
+    return port == leftMotor ? 0 : 1;
+}
+
+bool replayOpen(const char *tracePath, const char *outputPath) {
+    trace = fopen(tracePath, "r");
+    if(!trace) {
+        return false;
+    }
+
+    output = outputPath ? fopen(outputPath, "w") : stdout;
+
+    if(!readSample(sample)) {
+        return false;
+    }
+    hasNext = readSample(next);
+    timeUs = (long long)sample.time * 1000;
+
+    for(int i = 0; i < HOST_MOTOR_COUNT; i++) {
+        motors[i] = 0;
+    }
+    for(int i = 0; i < HOST_SENSOR_COUNT; i++) {
+        written[i] = -1;
+    }
+    encoderOffset[0] = encoderOffset[1] = 0;
+    return true;
+}
+
+void replayClose() {
+    if(trace) {
+        fclose(trace);
+    }
+    if(output && output != stdout) {
+        fclose(output);
+    }
+}
+
+int replayGetSensor(int port) {
+    advance(REPLAY_READ_COST_US);
+    return written[port] >= 0 ? written[port] : sample.sensors[port];
+}
+
+void replaySetSensor(int port, int value) {
+    written[port] = value;
+}
+
+int replayGetMotor(int port) {
+    return motors[port];
+}
+
+void replaySetMotor(int port, int value) {
+    if(motors[port] != value) {
+        fprintf(output, "%lld motor %d %d\n", timeUs / 1000, port, value);
+    }
+    motors[port] = value;
+}
+
+long replayGetEncoder(int port) {
+    advance(REPLAY_READ_COST_US);
+    return sample.encoders[encoderIndex(port)] - encoderOffset[encoderIndex(port)];
+}
+
+void replayResetEncoder(int port) {
+    encoderOffset[encoderIndex(port)] = sample.encoders[encoderIndex(port)];
+}
+
+long replayGetMicros() {
+    return timeUs;
+}
+
+// Traces don't record the battery, so report
+// a fully charged pack.
+int replayGetBattery() {
+    return REPLAY_BATTERY_MV;
+}
+
+long hostGetTime() {
+    return timeUs / 1000;
+}
+
+void hostWait(int ms) {
+    advance((long long)ms * 1000);
+}
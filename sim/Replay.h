@@ -0,0 +1,36 @@
+//======================================
+// Trace replay backend for the HAL. Feeds
+// recorded sensor and encoder values back
+// into the control code and records the
+// motor commands it produces, so a run can
+// be reproduced offline without a robot.
+//
+// Trace format, one sample per line:
+//   time_ms s0 s1 ... sN enc_left enc_right
+// where s0..sN follow the tSensors order in
+// sim/RobotC.h. Lines starting with # are
+// ignored. The file is streamed, so traces
+// of any length can be replayed.
+//======================================
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "RobotC.h"
+
+// Thrown when the control code runs past the end of the trace.
+struct ReplayEnd {};
+
+bool replayOpen(const char *tracePath, const char *outputPath);
+void replayClose();
+
+int  replayGetSensor(int port);
+void replaySetSensor(int port, int value);
+int  replayGetMotor(int port);
+void replaySetMotor(int port, int value);
+long replayGetEncoder(int port);
+void replayResetEncoder(int port);
+long replayGetMicros();
+int  replayGetBattery();
+
+#endif
@@ -0,0 +1,72 @@
+//======================================
+// Host shim for the ROBOTC language. It
+// maps the handful of ROBOTC built-ins
+// used by src/ onto standard C++ so the
+// robot code can be compiled on Linux
+// against the simulator or trace replay
+// HAL backends.
+//
+// The port names below must match the
+// #pragma config block in src/main.c.
+//======================================
+
+#ifndef ROBOTC_SHIM_H
+#define ROBOTC_SHIM_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+using std::abs;
+using std::sqrt;
+
+#define task void
+
+typedef enum {
+    testing,
+    rightLightSensor,
+    lightSensor2,
+    lightSensor,
+    towerPot,
+    topButton,
+    ultrasonic,
+    button2,
+    limitSwitch,
+    LED1,
+    LED2,
+    HOST_SENSOR_COUNT
+} tSensors;
+
+typedef enum {
+    rightMotor,
+    cableMotor,
+    towerMotor,
+    leftMotor,
+    HOST_MOTOR_COUNT
+} tMotor;
+
+// Provided by whichever host backend is linked in.
+long hostGetTime();
+void hostWait(int ms);
+
+/**
+ * Wall-clock monotonic time on the host, for
+ * measuring how long host runs actually take.
+ * Robot code uses the backend's own clock.
+ */
+inline long long hostMonotonicMicros() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+#define nPgmTime hostGetTime()
+#define nSysTime hostGetTime()
+#define wait1Msec(ms) hostWait(ms)
+
+#define writeDebugStream(...)     printf(__VA_ARGS__)
+#define writeDebugStreamLine(...) (printf(__VA_ARGS__), printf("\n"))
+#define clearDebugStream()
+
+#endif
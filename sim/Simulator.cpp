@@ -0,0 +1,487 @@
+//======================================
+// Kinematic simulator for Okarito. The
+// physical constants here describe the
+// real robot and arena, and are kept
+// separate from src/Constants.h on
+// purpose: the simulator is the "truth"
+// the control code is tuned against.
+//======================================
+
+#include "Simulator.h"
+#include "../src/RobotConfig.h"
+
+// The chassis being simulated, picked by the
+// same ROBOT_VARIANT as the robot code.
+#if ROBOT_VARIANT == VARIANT_OKARITO
+const float SIM_TICKS_PER_CM       = 19.6500;   // ticks
+const float SIM_TRACK_WIDTH        = 21.78;     // cm
+const float SIM_MAX_WHEEL_SPEED    = 55;        // cm/s at full power
+const float SIM_WHEEL_TAU          = 0.08;      // s
+const float SIM_FRONT_OFFSET       = 15;        // cm
+#elif ROBOT_VARIANT == VARIANT_PRACTICE
+const float SIM_TICKS_PER_CM       = 15.1150;   // ticks
+const float SIM_TRACK_WIDTH        = 27.3;      // cm
+const float SIM_MAX_WHEEL_SPEED    = 50;        // cm/s at full power
+const float SIM_WHEEL_TAU          = 0.1;       // s
+const float SIM_FRONT_OFFSET       = 12;        // cm
+#endif
+
+const float SIM_ARENA              = 230;       // cm
+const float SIM_TOWER_MAX_SPEED    = 220;       // deg/s at full power
+const float SIM_TOWER_TAU          = 0.03;      // s
+const int   SIM_TOWER_DEADBAND     = 8;         // power
+const float SIM_TOWER_MIN_DEG      = -120;      // deg
+const float SIM_TOWER_MAX_DEG      = 400;       // deg
+const float SIM_POT_TICKS_PER_DEG  = 7.08333;   // ticks
+const float SIM_POT_ZERO           = 805;       // ticks at 0 deg
+const float SIM_TOWER_BACKLASH     = 13.4;      // deg of play between the pot and the head
+const float SIM_SENSOR_SPREAD      = 6;         // deg
+const float SIM_SENSOR_WIDTH       = 12;        // deg
+const float SIM_LIGHT_AMBIENT      = 380;       //
+const float SIM_LIGHT_PEAK         = 3400;      //
+const float SIM_LIGHT_FALLOFF      = 300;       // cm
+const float SIM_LIGHT_POWER        = 1.3;       // falloff exponent, 1 is inverse square
+const int   SIM_CABLE_HELD         = 1000;      //
+const int   SIM_CABLE_FREE         = 1600;      //
+const float SIM_BEACON_RADIUS      = 5;         // cm
+const float SIM_SONAR_CONE         = 15;        // deg
+const float SIM_SONAR_MAX          = 300;       // cm
+const int   SIM_STEP_US            = 1000;      // us
+const int   SIM_TRACE_US           = 10000;     // us between trace samples
+const int   SIM_READ_COST_US       = 20;        // us
+const float SIM_BATTERY_FULL       = 7800;      // mV the speeds above are measured at
+const int   SIM_RELOAD_MS          = 1000;      // ms to reload the cable after a connection
+const int   SIM_FAULT_POT_MIN      = 200;       // ticks, smallest pot spike
+const int   SIM_FAULT_POT_MAX      = 800;       // ticks, largest pot spike
+const int   SIM_FAULT_AMBIENT_MAX  = 500;       // largest ambient light step
+
+// Each thread simulates its own world.
+static thread_local SimWorld *current = 0;
+
+static float wrap180(float deg) {
+    while(deg > 180) {
+        deg -= 360;
+    }
+    while(deg < -180) {
+        deg += 360;
+    }
+    return deg;
+}
+
+static float clampf(float value, float lo, float hi) {
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+static float frontX(SimWorld &w) {
+    return w.x + SIM_FRONT_OFFSET * cos(w.theta * M_PI / 180);
+}
+
+static float frontY(SimWorld &w) {
+    return w.y + SIM_FRONT_OFFSET * sin(w.theta * M_PI / 180);
+}
+
+/**
+ * Bearing of the beacon relative to the
+ * robot's heading, CCW positive.
+ */
+static float beaconBearing(SimWorld &w) {
+    float world = atan2(w.beaconY - w.y, w.beaconX - w.x) * 180 / M_PI;
+    return wrap180(world - w.theta);
+}
+
+/**
+ * Simulated phototransistor reading for a
+ * sensor aimed at the given lighthouse angle.
+ * The lighthouse angle is measured from the
+ * back of the robot, clockwise, so 180 faces
+ * straight ahead.
+ *
+ * The falloff is deliberately not the shape
+ * src/LightRange.c fits, and the ambient
+ * level is not LIGHT_AMBIENT, so the sim
+ * tests the fit and the ambient measurement
+ * rather than agreeing with them by
+ * construction.
+ */
+static int lightReading(SimWorld &w, float aimDeg) {
+    float beaconAngle = 180 - beaconBearing(w);
+    float error = wrap180(beaconAngle - aimDeg) / SIM_SENSOR_WIDTH;
+    float range = simBeaconDistance(w) / SIM_LIGHT_FALLOFF;
+    float value = SIM_LIGHT_AMBIENT + SIM_LIGHT_PEAK * exp(-0.5 * error * error) / pow(1 + range * range, SIM_LIGHT_POWER);
+    return (int)clampf(value, 0, 4095);
+}
+
+static int sonarReading(SimWorld &w) {
+    float fx = frontX(w);
+    float fy = frontY(w);
+
+    if(fabs(beaconBearing(w)) < SIM_SONAR_CONE) {
+        float d = sqrt((w.beaconX - fx) * (w.beaconX - fx) + (w.beaconY - fy) * (w.beaconY - fy)) - SIM_BEACON_RADIUS;
+        return d > SIM_SONAR_MAX ? -1 : (int)clampf(d, 0, SIM_SONAR_MAX);
+    }
+
+    // Otherwise the echo comes off the arena wall.
+    float c = cos(w.theta * M_PI / 180);
+    float s = sin(w.theta * M_PI / 180);
+    float d = SIM_SONAR_MAX + 1;
+
+    if(c > 1e-3)  d = fminf(d, (SIM_ARENA - fx) / c);
+    if(c < -1e-3) d = fminf(d, -fx / c);
+    if(s > 1e-3)  d = fminf(d, (SIM_ARENA - fy) / s);
+    if(s < -1e-3) d = fminf(d, -fy / s);
+
+    return d > SIM_SONAR_MAX ? -1 : (int)d;
+}
+
+static float approach(float speed, int power, float maxSpeed, float tau) {
+    float target = clampf(power, -127, 127) / 127.0 * maxSpeed;
+    return speed + (target - speed) * (SIM_STEP_US / 1e6) / tau;
+}
+
+/**
+ * Advances the physics by one fixed step.
+ */
+static void step(SimWorld &w) {
+    float dt = SIM_STEP_US / 1e6;
+
+    // Motor speed is proportional to the voltage
+    // across it, so a flat pack slows everything.
+    float volts = w.batteryMv / SIM_BATTERY_FULL;
+
+    w.leftSpeed  = approach(w.leftSpeed, w.motors[leftMotor], SIM_MAX_WHEEL_SPEED * volts, SIM_WHEEL_TAU);
+    w.rightSpeed = approach(w.rightSpeed, w.motors[rightMotor], SIM_MAX_WHEEL_SPEED * volts, SIM_WHEEL_TAU);
+
+    w.leftTicks  += w.leftSpeed * dt * SIM_TICKS_PER_CM;
+    w.rightTicks += w.rightSpeed * dt * SIM_TICKS_PER_CM;
+
+    float v = (w.leftSpeed + w.rightSpeed) / 2;
+    float omega = (w.rightSpeed - w.leftSpeed) / SIM_TRACK_WIDTH * 180 / M_PI;
+
+    float oldX = w.x;
+    float oldY = w.y;
+
+    w.theta = wrap180(w.theta + omega * dt);
+    w.x = clampf(w.x + v * cos(w.theta * M_PI / 180) * dt, SIM_FRONT_OFFSET, SIM_ARENA - SIM_FRONT_OFFSET);
+    w.y = clampf(w.y + v * sin(w.theta * M_PI / 180) * dt, SIM_FRONT_OFFSET, SIM_ARENA - SIM_FRONT_OFFSET);
+
+    // The beacon is solid: contact attaches the cable
+    // and stops the robot from driving through it.
+    float fx = frontX(w);
+    float fy = frontY(w);
+    float contact = sqrt((w.beaconX - fx) * (w.beaconX - fx) + (w.beaconY - fy) * (w.beaconY - fy));
+
+    if(contact < SIM_BEACON_RADIUS + 1) {
+        if(!w.connected) {
+            w.connected = true;
+            w.lastConnectTime = w.timeUs / 1000;
+            if(w.connections == 0) {
+                w.connectTime = w.lastConnectTime;
+            }
+            w.connections++;
+        }
+        w.x = oldX;
+        w.y = oldY;
+    }
+
+    // Reload the cable and move the beacon to the
+    // opposite side of the arena for the next target.
+    if(w.connected && w.timeUs / 1000 - w.lastConnectTime > SIM_RELOAD_MS) {
+        w.connected = false;
+        w.beaconX = SIM_ARENA - w.beaconX;
+        w.beaconY = SIM_ARENA - w.beaconY;
+    }
+
+    int towerPower = abs(w.motors[towerMotor] * volts) < SIM_TOWER_DEADBAND ? 0 : w.motors[towerMotor];
+    w.towerSpeed = approach(w.towerSpeed, towerPower, SIM_TOWER_MAX_SPEED * volts, SIM_TOWER_TAU);
+    w.towerDeg = clampf(w.towerDeg + w.towerSpeed * dt, SIM_TOWER_MIN_DEG, SIM_TOWER_MAX_DEG);
+    w.headDeg = clampf(w.headDeg, w.towerDeg - SIM_TOWER_BACKLASH / 2, w.towerDeg + SIM_TOWER_BACKLASH / 2);
+}
+
+static int sensorReading(SimWorld &w, int port);
+
+/**
+ * Writes one line of the world's trace, in
+ * the replay backend's format, so a simulated
+ * run can be fed to the replay backend or the
+ * noise tool like a recorded one.
+ */
+static void traceSample(SimWorld &w) {
+    fprintf(w.trace, "%lld", w.physicsUs / 1000);
+    for(int i = 0; i < HOST_SENSOR_COUNT; i++) {
+        fprintf(w.trace, " %d", sensorReading(w, i));
+    }
+    fprintf(w.trace, " %ld %ld\n", (long)w.leftTicks, (long)w.rightTicks);
+}
+
+static void advance(long long us) {
+    SimWorld &w = *current;
+    w.timeUs += us;
+
+    while(w.physicsUs + SIM_STEP_US <= w.timeUs) {
+        step(w);
+        w.physicsUs += SIM_STEP_US;
+
+        if(w.trace && w.physicsUs % SIM_TRACE_US == 0) {
+            traceSample(w);
+        }
+    }
+
+    if(w.timeLimitUs > 0 && w.timeUs > w.timeLimitUs) {
+        throw SimTimeout();
+    }
+}
+
+//======================================
+// Fault injection
+//======================================
+
+static const char *FAULT_NAMES[SIM_FAULT_COUNT] = {
+    "sonar_dropout",
+    "light_saturation",
+    "encoder_glitch",
+    "pot_spike",
+    "ambient_light",
+};
+
+/**
+ * xorshift32, so a seed gives the same faults
+ * on every host.
+ */
+static float faultRandom(SimFault &f) {
+    f.rng ^= f.rng << 13;
+    f.rng ^= f.rng >> 17;
+    f.rng ^= f.rng << 5;
+    return (f.rng >> 8) / 16777216.0f;
+}
+
+/**
+ * Draws the next event of a fault, starting
+ * the wait for it at the given time.
+ */
+static void faultSchedule(SimFault &f, long long fromUs) {
+    float gap = -log(1 - faultRandom(f)) / f.rate;
+    float length = f.durationMs * (0.5 + faultRandom(f));
+
+    f.start = fromUs + (long long)(gap * 1e6);
+    f.end = f.start + (long long)(length * 1000);
+    f.side = faultRandom(f) < 0.5 ? -1 : 1;
+    f.magnitude = faultRandom(f);
+}
+
+static bool faultActive(SimFault &f, long long nowUs) {
+    if(f.rate <= 0) {
+        return false;
+    }
+
+    while(nowUs >= f.end) {
+        faultSchedule(f, f.end);
+    }
+    return nowUs >= f.start;
+}
+
+/**
+ * Applies whichever faults are active to a
+ * sensor reading.
+ */
+static int injectSensorFault(SimWorld &w, int port, int value) {
+    long long now = w.timeUs;
+
+    switch(port) {
+    case ultrasonic:
+        if(faultActive(w.faults[SIM_FAULT_SONAR_DROPOUT], now)) {
+            value = -1;
+        }
+        break;
+    case towerPot:
+        if(faultActive(w.faults[SIM_FAULT_POT_SPIKE], now)) {
+            SimFault &f = w.faults[SIM_FAULT_POT_SPIKE];
+            value += f.side * (SIM_FAULT_POT_MIN + f.magnitude * (SIM_FAULT_POT_MAX - SIM_FAULT_POT_MIN));
+        }
+        break;
+    case rightLightSensor:
+    case lightSensor2:
+    case lightSensor:
+        if(faultActive(w.faults[SIM_FAULT_AMBIENT_LIGHT], now)) {
+            value += w.faults[SIM_FAULT_AMBIENT_LIGHT].magnitude * SIM_FAULT_AMBIENT_MAX;
+        }
+
+        // Glare saturates one of the two beacon
+        // sensors at a time.
+        if(faultActive(w.faults[SIM_FAULT_LIGHT_SATURATION], now)) {
+            int side = w.faults[SIM_FAULT_LIGHT_SATURATION].side;
+            if((side < 0 && port == lightSensor2) || (side > 0 && port == rightLightSensor)) {
+                value = 4095;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    return (int)clampf(value, -1, 4095);
+}
+
+void simFaultsInit(SimWorld &world, unsigned int seed) {
+    for(int i = 0; i < SIM_FAULT_COUNT; i++) {
+        SimFault &f = world.faults[i];
+        f.rate = 0;
+        f.durationMs = 0;
+        f.rng = seed * 2654435761u + i * 40503u + 1;
+        f.start = f.end = 0;
+        f.side = 1;
+        f.magnitude = 0;
+    }
+}
+
+void simFaultEnable(SimWorld &world, int fault, float rate, float durationMs) {
+    SimFault &f = world.faults[fault];
+    f.rate = rate;
+    f.durationMs = durationMs;
+
+    if(rate > 0) {
+        faultSchedule(f, world.timeUs);
+    }
+}
+
+const char *simFaultName(int fault) {
+    return fault >= 0 && fault < SIM_FAULT_COUNT ? FAULT_NAMES[fault] : "none";
+}
+
+void simInit(SimWorld &world, float x, float y, float theta, float beaconX, float beaconY) {
+    world.x = x;
+    world.y = y;
+    world.theta = theta;
+    world.leftSpeed = world.rightSpeed = 0;
+    world.leftTicks = world.rightTicks = 0;
+    world.leftTickOffset = world.rightTickOffset = 0;
+
+    world.towerDeg = SIM_TOWER_MIN_DEG + 5;
+    world.headDeg = world.towerDeg;
+    world.batteryMv = SIM_BATTERY_FULL;
+    world.towerSpeed = 0;
+
+    world.beaconX = beaconX;
+    world.beaconY = beaconY;
+    world.connected = false;
+    world.connectTime = 0;
+    world.connections = 0;
+    world.lastConnectTime = 0;
+
+    world.pressStart = 300;
+    world.pressEnd = 400;
+
+    for(int i = 0; i < HOST_MOTOR_COUNT; i++) {
+        world.motors[i] = 0;
+    }
+    for(int i = 0; i < HOST_SENSOR_COUNT; i++) {
+        world.sensors[i] = 0;
+    }
+
+    world.timeUs = 0;
+    world.physicsUs = 0;
+    world.timeLimitUs = 0;
+    world.trace = 0;
+
+    simFaultsInit(world, 1);
+}
+
+void simBind(SimWorld &world) {
+    current = &world;
+}
+
+SimWorld &simWorld() {
+    return *current;
+}
+
+float simBeaconDistance(SimWorld &w) {
+    return sqrt((w.beaconX - w.x) * (w.beaconX - w.x) + (w.beaconY - w.y) * (w.beaconY - w.y));
+}
+
+/**
+ * What a sensor reads right now, faults and
+ * all. Reading it doesn't take any time.
+ */
+static int sensorReading(SimWorld &w, int port) {
+    long ms = w.timeUs / 1000;
+    int value;
+
+    switch(port) {
+    case rightLightSensor:
+        value = lightReading(w, w.headDeg + SIM_SENSOR_SPREAD);
+        break;
+    case lightSensor2:
+        value = lightReading(w, w.headDeg - SIM_SENSOR_SPREAD);
+        break;
+    case lightSensor:
+        value = w.connected ? SIM_CABLE_FREE : SIM_CABLE_HELD;
+        break;
+    case towerPot:
+        value = (int)clampf(w.towerDeg * SIM_POT_TICKS_PER_DEG + SIM_POT_ZERO, 0, 4095);
+        break;
+    case ultrasonic:
+        value = sonarReading(w);
+        break;
+    case topButton:
+        value = ms >= w.pressStart && ms < w.pressEnd;
+        break;
+    default:
+        value = w.sensors[port];
+    }
+
+    return injectSensorFault(w, port, value);
+}
+
+int simGetSensor(int port) {
+    advance(SIM_READ_COST_US);
+    return sensorReading(*current, port);
+}
+
+void simSetSensor(int port, int value) {
+    current->sensors[port] = value;
+}
+
+int simGetMotor(int port) {
+    return current->motors[port];
+}
+
+void simSetMotor(int port, int value) {
+    current->motors[port] = (int)clampf(value, -127, 127);
+}
+
+long simGetEncoder(int port) {
+    advance(SIM_READ_COST_US);
+    SimWorld &w = *current;
+
+    // A failed I2C transaction reads back as zero.
+    if(faultActive(w.faults[SIM_FAULT_ENCODER_GLITCH], w.timeUs)) {
+        return 0;
+    }
+
+    return port == leftMotor ? (long)(w.leftTicks - w.leftTickOffset) : (long)(w.rightTicks - w.rightTickOffset);
+}
+
+void simResetEncoder(int port) {
+    SimWorld &w = *current;
+    if(port == leftMotor) {
+        w.leftTickOffset = w.leftTicks;
+    }
+    else {
+        w.rightTickOffset = w.rightTicks;
+    }
+}
+
+long simGetMicros() {
+    return current->timeUs;
+}
+
+int simGetBattery() {
+    return (int)current->batteryMv;
+}
+
+long hostGetTime() {
+    return current->timeUs / 1000;
+}
+
+void hostWait(int ms) {
+    advance((long long)ms * 1000);
+}
@@ -0,0 +1,108 @@
+//======================================
+// Kinematic simulator for Okarito and the
+// 2.3m x 2.3m arena. Backs the HAL_SIM
+// hardware backend (see src/HAL.h).
+//
+// Units: cm, degrees, microseconds.
+// World frame: origin in the bottom-left
+// corner, theta measured CCW from +x.
+//======================================
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "RobotC.h"
+
+// Fault classes for the injection stage that
+// sits between the simulated sensors and the
+// control code.
+typedef enum {
+    SIM_FAULT_SONAR_DROPOUT,
+    SIM_FAULT_LIGHT_SATURATION,
+    SIM_FAULT_ENCODER_GLITCH,
+    SIM_FAULT_POT_SPIKE,
+    SIM_FAULT_AMBIENT_LIGHT,
+    SIM_FAULT_COUNT
+} SimFaultClass;
+
+// One fault class. Events arrive at random at
+// the given rate and each lasts about
+// durationMs. The schedule only depends on the
+// seed and the simulated time, never on how
+// often the control code reads the sensor, so
+// a seed always produces the same faults.
+typedef struct {
+    float rate;
+    float durationMs;
+    unsigned int rng;
+    long long start, end;
+    int side;
+    float magnitude;
+} SimFault;
+
+typedef struct {
+    // Robot pose and wheel state.
+    float x, y, theta;
+    float leftSpeed, rightSpeed;
+    float leftTicks, rightTicks;
+    float leftTickOffset, rightTickOffset;
+
+    // Lighthouse assembly. The pot reads towerDeg;
+    // the head with the light sensors trails it
+    // through the gear play.
+    float towerDeg;
+    float towerSpeed;
+    float headDeg;
+
+    // Beacon. After each connection the cable is
+    // reloaded and the beacon moved, for missions
+    // with more than one target.
+    float beaconX, beaconY;
+    bool connected;
+    long connectTime;
+    int connections;
+    long lastConnectTime;
+
+    // Buttons are pressed for this window (ms).
+    long pressStart, pressEnd;
+
+    // Battery voltage (mV), scales every motor.
+    float batteryMv;
+
+    // Fault injection, off unless enabled.
+    SimFault faults[SIM_FAULT_COUNT];
+
+    int motors[HOST_MOTOR_COUNT];
+    int sensors[HOST_SENSOR_COUNT];
+
+    long long timeUs;
+    long long physicsUs;
+    long long timeLimitUs;
+
+    // Sensor trace, written every SIM_TRACE_US
+    // of simulated time if set.
+    FILE *trace;
+} SimWorld;
+
+// Thrown when the simulated run exceeds its time limit.
+struct SimTimeout {};
+
+void simInit(SimWorld &world, float x, float y, float theta, float beaconX, float beaconY);
+void simBind(SimWorld &world);
+SimWorld &simWorld();
+float simBeaconDistance(SimWorld &world);
+
+void simFaultsInit(SimWorld &world, unsigned int seed);
+void simFaultEnable(SimWorld &world, int fault, float rate, float durationMs);
+const char *simFaultName(int fault);
+
+int  simGetSensor(int port);
+void simSetSensor(int port, int value);
+int  simGetMotor(int port);
+void simSetMotor(int port, int value);
+long simGetEncoder(int port);
+void simResetEncoder(int port);
+long simGetMicros();
+int  simGetBattery();
+
+#endif
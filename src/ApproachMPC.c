@@ -0,0 +1,167 @@
+/**
+ * This class contains the model-predictive
+ * approach planner. Every tick it tries a set
+ * of arcs at a couple of speeds, predicts
+ * where each one takes the robot over a short
+ * horizon with a simple differential-drive
+ * model, and picks the one that reaches the
+ * beacon soonest without losing it from the
+ * lighthouse's view or running into anything
+ * on the map.
+ *
+ * The model starts from the measured wheel
+ * speeds (see Odometry.c) and lags each wheel
+ * towards its command with a first order time
+ * constant. Everything is done in the robot's
+ * frame at the start of the tick, and the
+ * heading is rotated incrementally, so a
+ * rollout needs no trig.
+ *
+ * @author Jayden Chan
+ * @date April 17, 2018
+ */
+
+#ifndef APPROACHMPC_C
+#define APPROACHMPC_C
+
+#include "Constants.h"
+#include "Robot.c"
+#include "OccupancyGrid.c"
+#include "Utils.c"
+
+/**
+ * Predicts one candidate over the horizon.
+ *
+ * @param robot The robot's state.
+ * @param fwd The beacon's distance ahead of
+ * the robot, in cm.
+ * @param side The beacon's distance to the
+ * left of the robot, in cm.
+ * @param left The left wheel's commanded speed
+ * in cm/s.
+ * @param right The right wheel's commanded
+ * speed in cm/s.
+ * @param speed The fastest either wheel can be
+ * commanded, in cm/s.
+ * @return The predicted time to reach the
+ * beacon in seconds, or -1 if the candidate
+ * loses sight of it.
+ */
+float mpcRollout(Robot &robot, float fwd, float side, float left, float right, float speed) {
+    float lag = MPC_STEP / (MPC_WHEEL_TAU + MPC_STEP);
+
+    float vl = robot.leftSpeed;
+    float vr = robot.rightSpeed;
+    float x = 0;
+    float y = 0;
+    float c = 1;
+    float s = 0;
+
+    for(int i = 1; i <= MPC_HORIZON; i++) {
+        vl += (left - vl) * lag;
+        vr += (right - vr) * lag;
+
+        float v = (vl + vr) / 2 * MPC_STEP;
+        float w = (vr - vl) / DRIVETRAIN_WIDTH * MPC_STEP;
+
+        // Small angle rotation of the heading.
+        float nc = c - s * w;
+        s = s + c * w;
+        c = nc;
+
+        x += v * c;
+        y += v * s;
+
+        // The beacon in the predicted robot frame.
+        float dx = fwd - x;
+        float dy = side - y;
+        float ahead = dx * c + dy * s;
+        float across = dy * c - dx * s;
+
+        float gap = ahead - SONAR_OFFSET;
+        if(gap * gap + across * across < MPC_CONTACT_RANGE * MPC_CONTACT_RANGE) {
+            return i * MPC_STEP;
+        }
+
+        if(ahead <= 0 || abs(across) > ahead * MPC_VIEW_SLOPE) {
+            return -1;
+        }
+    }
+
+    // Not there yet, so add an estimate of the
+    // rest: the straight line distance plus the
+    // time to turn the remaining heading error.
+    float dx = fwd - x;
+    float dy = side - y;
+    float ahead = dx * c + dy * s;
+    float across = dy * c - dx * s;
+    float dist = sqrt(ahead * ahead + across * across);
+
+    return MPC_HORIZON * MPC_STEP
+         + (dist - SONAR_OFFSET) / speed
+         + abs(across) / dist * DRIVETRAIN_WIDTH / 2 / speed;
+}
+
+/**
+ * Picks the wheel powers for this tick of the
+ * approach. Only works while the beacon's
+ * position is known; otherwise the tracking
+ * controller has to steer.
+ *
+ * @param robot The robot's state.
+ * @param maxSpeed The fastest either side may
+ * be driven, in motor power.
+ * @param left The left side's power, if a plan
+ * was found.
+ * @param right The right side's power, if a
+ * plan was found.
+ * @return Whether a plan was found.
+ */
+bool mpcPlan(Robot &robot, float maxSpeed, float &left, float &right) {
+    if(!robot.beaconKnown) {
+        return false;
+    }
+
+    float c = cos(robot.poseTheta);
+    float s = sin(robot.poseTheta);
+    float dx = robot.beaconX - robot.poseX;
+    float dy = robot.beaconY - robot.poseY;
+    float fwd = dx * c + dy * s;
+    float side = dy * c - dx * s;
+
+    bool checkMap = gridOccupied(robot.grid) > 0;
+    float top = maxSpeed / MAX_SPEED * DRIVE_TOP_SPEED;
+    float best = -1;
+
+    for(int i = 0; i < MPC_SPEEDS; i++) {
+        float speed = top * MPC_SPEED[i];
+
+        for(int j = 0; j < MPC_CURVATURES; j++) {
+            float k = MPC_CURVATURE[j] * DRIVETRAIN_WIDTH / 2;
+
+            // Keep the faster wheel at the candidate's
+            // speed.
+            float l = speed * (1 - k) / (1 + abs(k));
+            float r = speed * (1 + k) / (1 + abs(k));
+
+            float cost = mpcRollout(robot, fwd, side, l, r, top);
+
+            if(cost < 0 || (best >= 0 && cost >= best)) {
+                continue;
+            }
+
+            if(checkMap && !gridArcClear(robot.grid, robot.poseX, robot.poseY, robot.poseTheta,
+                                         MPC_CURVATURE[j], speed * MPC_HORIZON * MPC_STEP, PATH_CLEARANCE)) {
+                continue;
+            }
+
+            best = cost;
+            left = l / DRIVE_TOP_SPEED * MAX_SPEED;
+            right = r / DRIVE_TOP_SPEED * MAX_SPEED;
+        }
+    }
+
+    return best >= 0;
+}
+
+#endif
@@ -8,7 +8,11 @@
  * @date February 16, 2018
  */
 
+#ifndef ARM_C
+#define ARM_C
+
 #include "Constants.h"
+#include "HAL.h"
 
 /**
  * Returns true or false depending on whether
@@ -25,6 +29,8 @@
  * @return Whether the cable is connected or not.
  */
 bool isCableDetached(float defaultValue) {
-    float sensorDelta = abs(SensorValue[lightSensor] - defaultValue);
+    float sensorDelta = abs(halGetSensor(lightSensor) - defaultValue);
     return sensorDelta > CABLE_SENSOR_DELTA;
 }
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * This class compensates motor commands for
+ * the main battery's voltage. All of the
+ * robot's timings and gains were tuned on a
+ * pack at BATTERY_NOMINAL; as the pack sags,
+ * the same power gives less voltage across the
+ * motors, so every command is scaled up to
+ * deliver what it would have at nominal.
+ *
+ * @author Jayden Chan
+ * @date April 14, 2018
+ */
+
+#ifndef BATTERY_C
+#define BATTERY_C
+
+#include "Constants.h"
+#include "Utils.c"
+#include "HAL.h"
+
+/**
+ * Gets the factor motor commands need to be
+ * scaled by to behave as they would at
+ * BATTERY_NOMINAL. Readings below BATTERY_MIN
+ * are treated as BATTERY_MIN, so a bad reading
+ * can't blow up the gain.
+ *
+ * @return The compensation factor.
+ */
+float batteryScale() {
+    float level = halGetBattery();
+
+    if(level < BATTERY_MIN) {
+        level = BATTERY_MIN;
+    }
+
+    return BATTERY_NOMINAL / level;
+}
+
+/**
+ * Sets a motor's power, compensated for the
+ * battery voltage. Use this instead of writing
+ * to the motor directly.
+ *
+ * @param port The motor to set.
+ * @param power The power at nominal voltage.
+ */
+void setMotor(tMotor port, float power) {
+    halSetMotor(port, clamp(power * batteryScale(), MAX_SPEED));
+}
+
+#endif
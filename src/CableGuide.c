@@ -6,24 +6,92 @@
  * to separate the cable from the robot at the
  * end of the connection sequence.
  *
+ * The cable motor has no encoder and the
+ * Cortex can't measure motor current, so a
+ * move ends after CABLE_GUIDE_TIME. The power
+ * is compensated for the battery like every
+ * other motor, which keeps the travel the same
+ * as the pack runs down.
+ *
+ * The guide is lowered while the robot
+ * approaches the beacon and raised while it
+ * backs away, each alongside the drive.
+ *
  * @author Jayden Chan
  * @date March 22, 2018
  */
 
+#ifndef CABLEGUIDE_C
+#define CABLEGUIDE_C
+
+#include "Constants.h"
+#include "Robot.c"
+#include "Timebase.c"
+#include "Battery.c"
+#include "HAL.h"
+
+/**
+ * Starts moving the cable guide. Call
+ * cableGuideStep() every tick until it returns
+ * true; the guide can move while other
+ * maneuvers run. If the guide is already
+ * there, it isn't moved.
+ *
+ * @param robot The robot's state.
+ * @param down Whether to lower the guide
+ * rather than raise it.
+ */
+void cableGuideStart(Robot &robot, bool down) {
+    if(robot.guideDown == down) {
+        return;
+    }
+
+    robot.guideDown = down;
+    robot.guideEnd = timeMicros() + CABLE_GUIDE_TIME * 1000;
+    robot.guideMoving = true;
+
+    setMotor(cableMotor, down ? CABLE_GUIDE_SPEED : -CABLE_GUIDE_SPEED);
+}
+
+/**
+ * Runs one tick of a cable guide move.
+ *
+ * @param robot The robot's state.
+ * @return Whether the move has finished.
+ */
+bool cableGuideStep(Robot &robot) {
+    if(robot.guideMoving && (long)(timeMicros() - robot.guideEnd) >= 0) {
+        setMotor(cableMotor, 0);
+        robot.guideMoving = false;
+    }
+
+    return !robot.guideMoving;
+}
+
 /**
  * Lowers the cable guide.
+ *
+ * @param robot The robot's state.
  */
-void cableGuideDown() {
-    motor[cableMotor] = 20;
-    wait1Msec(340);
-    motor[cableMotor] = 0;
+void cableGuideDown(Robot &robot) {
+    cableGuideStart(robot, true);
+
+    while(!cableGuideStep(robot)) {
+        execTick(robot.exec, robot.log);
+    }
 }
 
 /**
  * Raises the cable guide.
+ *
+ * @param robot The robot's state.
  */
-void cableGuideUp() {
-    motor[cableMotor] = -20;
-    wait1Msec(340);
-    motor[cableMotor] = 0;
+void cableGuideUp(Robot &robot) {
+    cableGuideStart(robot, false);
+
+    while(!cableGuideStep(robot)) {
+        execTick(robot.exec, robot.log);
+    }
 }
+
+#endif
@@ -1,28 +1,118 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
+#include "RobotConfig.h"
+
 // Type            Name                Value                           Units
 const int   MAX_SPEED           = 127;                          //
 const float TICKS_PER_DEG       = 7.08333333333;                // ticks
-const float TICKS_PER_ROT       = 627.2;                        // ticks
-const float WHEEL_CIRC          = 31.91858136;                  // cm
-const float TICKS_PER_CM2       = (TICKS_PER_ROT / WHEEL_CIRC); // ticks
-const float DRIVETRAIN_WIDTH    = 21.78;                        // cm
+const float TICKS_PER_ROT       = CFG_TICKS_PER_ROT;            // ticks
+const float WHEEL_CIRC          = CFG_WHEEL_CIRC;               // cm
+const float TICKS_PER_CM2       = CFG_TICKS_PER_CM;             // ticks
+const float DRIVETRAIN_WIDTH    = CFG_DRIVETRAIN_WIDTH;         // cm
 const float MATH_PI             = 3.14159265359;                //
 const float ULTRASONIC_THRESH   = 0;                            // cm
 const int   CABLE_SENSOR_DELTA  = 275;                          //
 const int   POT_TRACKING_THRESH = 2100;                         // ticks
 const int   BEACON_FOUND_THRESH = 2200;                         //
 const int   BEACON_LOST_THRESH  = 1500;                         //
-const int   POT_OFFSET          = -895;                         // ticks
-const int   POT_OFFSET_LEFT     = -800;                         // ticks
+const float POT_ZERO            = 805;                          // ticks
+const float POT_BACKLASH        = 13.4;                         // deg
+const float SCAN_SENSOR_OFFSET  = 6;                            // deg
 const float TRACKING_SLOPE      = 0.007;                        //
 const float TRACKING_MIN        = 13.5;                         //
 const float TRACKING_TURN_SENS  = 290;                          //
 const float ULTRASONIC_SLEW     = 0.8;                          //
-      int   L_SENSOR_DIFF       = 0;                            //
+const bool  USE_COMBINED_SCAN   = true;                         //
+const int   EXEC_PERIOD         = 5;                            // ms
+const int   EXEC_OVERRUN_LOG    = 3;                            // entries
+const int   SETTLE_FAST_DWELL   = 40;                           // ms
+const float DRIVE_SETTLE_VEL    = 0.05;                         // ticks/ms
+const float TOWER_SETTLE_VEL    = 0.05;                         // ticks/ms
+const int   STALL_POWER         = 20;                           //
+const int   STALL_WINDOW        = 300;                          // ms
+const float DRIVE_STALL_VEL     = 0.02;                         // ticks/ms
+const float TOWER_STALL_VEL     = 0.02;                         // ticks/ms
+const int   CALIBRATE_TIMEOUT   = 3000;                         // ms
+const int   SCAN_STALL_RETRIES  = 1;                            //
+const int   RECOVER_SLEW_TIME   = 400;                          // ms
+const float RECOVER_SLEW_kP     = 0.5;                          //
+const int   RECOVER_SWEEP_TIME  = 2500;                         // ms
+const float RECOVER_SWEEP_DEG   = 45;                           // deg
+const int   RECOVER_SWEEP_SPEED = 40;                           //
+const float BATTERY_NOMINAL     = 7800;                         // mV
+const float BATTERY_MIN         = 6000;                         // mV
+const int   LOG_CAPACITY        = 8;                            // entries
+const int   LOG_RATE_MAX        = 60000;                        // ms, longest rate limit
+const int   LOG_FLUSH_SLACK     = 2;                            // ms left in a tick to write an entry
+const int   PROFILE_SAMPLE      = 2;                            // ms
+const int   PROFILE_DEPTH       = 6;                            // frames
+const int   PROFILE_STATES      = 10;                           //
+const float SCAN_START_DEG      = -120;                         // deg
+const int   QUIKBAK_SPEED       = 100;                          //
+const float QUIKBAK_DISTANCE    = 6.5;                          // cm
+const int   QUIKBAK_TIMEOUT     = 400;                          // ms
+const int   CABLE_GUIDE_SPEED   = 20;                           //
+const int   CABLE_GUIDE_TIME    = 340;                          // ms
+const float TIMEBASE_FILTER     = 0.25;                         //
+const int   LIGHT_AVERAGES      = 3;                            //
+const int   ROBOT_RAM_BUDGET    = 2048;                         // bytes
+const float SONAR_OFFSET        = CFG_SONAR_OFFSET;             // cm
+const float GRID_CELL           = 10;                           // cm
+const int   GRID_CAPACITY       = 64;                           // cells
+const int   GRID_MAX_HITS       = 7;                            //
+const int   GRID_HALF_SPAN      = 32;                           // cells
+const int   GRID_OCCUPIED       = 2;                            //
+const float GRID_SONAR_MAX      = 150;                          // cm
+const float PATH_CLEARANCE      = 15;                           // cm
+const float BEACON_CLEARANCE    = 20;                           // cm
+const float STEER_STEP          = 0.1;                          //
+const int   STEER_CANDIDATES    = 3;                            //
+const float ODOMETRY_SPEED_DT   = 0.02;                         // s
+const float ODOMETRY_GLITCH     = 2;                            // x the top speed
+const float ODOMETRY_SLACK      = 1;                            // cm
+const float SONAR_CONE          = 15;                           // deg
+const bool  USE_MPC_APPROACH    = true;                         //
+const float MPC_STEP            = 0.075;                        // s
+const int   MPC_HORIZON         = 8;                            // steps
+const float DRIVE_TOP_SPEED     = CFG_DRIVE_TOP_SPEED;          // cm/s
+const float MPC_WHEEL_TAU       = CFG_WHEEL_TAU;                // s
+const float MPC_CONTACT_RANGE   = 10;                           // cm
+const int   MPC_MIN_POWER       = 30;                           //
+const float MPC_VIEW_SLOPE      = 0.84;                         //
+const long  MPC_TICK_BUDGET     = 5000;                         // us
+const bool  USE_FAST_TURN       = true;                         //
+const float TURN_ACCEL          = 0.01;                         // ticks/ms^2
+const float TURN_DECEL          = 0.02;                         // ticks/ms^2
+const float TURN_LEARN_RATE     = 0.3;                          //
+const float TURN_BRAKE_VEL      = 0.05;                         // ticks/ms
+const float TURN_FINE_DEG       = 1;                            // deg
+const bool  USE_ARC_APPROACH    = true;                         //
+const float ARC_HANDOFF         = 30;                           // cm
+const float ARC_MIN_LENGTH      = 20;                           // cm
+const float ARC_MIN_RADIUS      = 10;                           // cm
+const float ARC_MAX_RADIUS      = 2000;                         // cm
+const float ARC_REPLAN          = 5;                            // cm
+const float LIGHT_AMBIENT       = 300;                          // until a scan measures it
+const float LIGHT_RANGE_A       = 0.335;                        // 1000/light
+const float LIGHT_RANGE_B       = 0.0591;                       // 1000/light per m^2
+const float LIGHT_RANGE_MIN     = 200;                          // above ambient
+const float LIGHT_RANGE_MAX     = 400;                          // cm
+const float LIGHT_RANGE_FILTER  = 0.1;                          //
+const float LIGHT_RANGE_SIGMA   = 0.15;                         // of the range
+const float LIGHT_SIGMA_MIN     = 10;                           // cm
+const float SONAR_SIGMA         = 2;                            // cm
+const int   LIGHT_CAL_PRIOR     = 20;                           // pairs
+const int   LIGHT_CAL_MAX       = 400;                          // pairs
+const float LIGHT_CAL_REJECT    = 0.3;                          // of the fit
+const float APPROACH_PLAN_RANGE = 120;                          // cm
+
+// PID Constants. The drive loops work in encoder
+// ticks, so their gains come in a set per gearing
+// (see RobotConfig.h). The speed set is the torque
+// set scaled by ticks per cm.
+#if ROBOT_GAINS == GAINS_393_TORQUE
 
-// PID Constants
 const float SLAVE_2_kP = 0.1;
 const float SLAVE_2_kI = 0.1;
 const float SLAVE_2_kD = 10;
@@ -33,24 +123,88 @@ const float SLAVE_kP = 0.05;
 const float SLAVE_kI = 0.0;
 const float SLAVE_kD = 10;
 const float SLAVE_kS = 99999;
-const int   SLAVE_kR = 1;
+const int   SLAVE_kR = 0;
+
+const float TURN_kP = 1;
+const float TURN_kI = 0;
+const float TURN_kD = 100;
+const float TURN_kS = 5;
+const int   TURN_kR = 0;
+
+const float APPROACH_SLAVE_kP[] = {0.05,  0.05,  0.07,  0.08};
+const float APPROACH_SLAVE_kI[] = {0.0,   0.0,   0.0,   0.0};
+const float APPROACH_SLAVE_kD[] = {10,    10,    10,    10};
+const float APPROACH_SLAVE_kS[] = {99999, 99999, 99999, 99999};
+
+#elif ROBOT_GAINS == GAINS_393_SPEED
+
+const float SLAVE_2_kP = 0.13;
+const float SLAVE_2_kI = 0.13;
+const float SLAVE_2_kD = 13;
+const float SLAVE_2_kS = 99999;
+const int   SLAVE_2_kR = 0;
+
+const float SLAVE_kP = 0.065;
+const float SLAVE_kI = 0.0;
+const float SLAVE_kD = 13;
+const float SLAVE_kS = 99999;
+const int   SLAVE_kR = 0;
+
+const float TURN_kP = 1.3;
+const float TURN_kI = 0;
+const float TURN_kD = 130;
+const float TURN_kS = 5;
+const int   TURN_kR = 0;
+
+const float APPROACH_SLAVE_kP[] = {0.065, 0.065, 0.09,  0.1};
+const float APPROACH_SLAVE_kI[] = {0.0,   0.0,   0.0,   0.0};
+const float APPROACH_SLAVE_kD[] = {13,    13,    13,    13};
+const float APPROACH_SLAVE_kS[] = {99999, 99999, 99999, 99999};
+
+#else
+#error "Unknown ROBOT_GAINS"
+#endif
 
 const float ULTRASONIC_kP = 1.7;
 const float ULTRASONIC_kI = 0.02;
 const float ULTRASONIC_kD = 8000;
 const float ULTRASONIC_kS = 0.22;
-const int   ULTRASONIC_kR = 10;
+const int   ULTRASONIC_kR = 0;
 
 const float LIGHTHOUSE_kP = 0.5;
 const float LIGHTHOUSE_kI = 0.0;
 const float LIGHTHOUSE_kD = 50;
 const float LIGHTHOUSE_kS = 999;
-const float LIGHTHOUSE_kR = 10;
+const float LIGHTHOUSE_kR = 0;
 
-const float TURN_kP = 1;
-const float TURN_kI = 0;
-const float TURN_kD = 100;
-const float TURN_kS = 5;
-const int   TURN_kR = 1;
+// Approach gain schedules, indexed by ultrasonic
+// range in cm and interpolated between rows.
+// APPROACH_BIAS replaces the fixed L_SENSOR_DIFF
+// steps at 40 cm and 20 cm.
+const int   GAIN_SCHEDULE_MAX = 6;
+const int   APPROACH_ROWS     = 4;
+
+const float APPROACH_RANGE[]  = {20,    40,    80,    150};
+const float APPROACH_kP[]     = {1.7,   1.7,   2.2,   2.5};
+const float APPROACH_kI[]     = {0.02,  0.02,  0.01,  0.0};
+const float APPROACH_kD[]     = {8000,  8000,  8000,  8000};
+const float APPROACH_kS[]     = {0.22,  0.22,  0.4,   0.6};
+const float APPROACH_BIAS[]   = {-200,  -100,  0,     0};
+
+// Approach planner candidates: speeds as a
+// fraction of the max, and arc curvatures in
+// 1/cm, positive to the left.
+const int   MPC_SPEEDS     = 2;
+const int   MPC_CURVATURES = 7;
+
+const float MPC_SPEED[]     = {1.0, 0.6};
+const float MPC_CURVATURE[] = {0, 0.005, -0.005, 0.012, -0.012, 0.025, -0.025};
+
+// Mission targets, one row per target. See
+// Mission.c for how many are used.
+const int   MISSION_MAX = 4;
+
+const int   MISSION_APPROACH_SPEED[]  = {127, 127, 127, 127};
+const int   MISSION_SCAN_TURN_SPEED[] = {40,  40,  40,  40};
 
 #endif
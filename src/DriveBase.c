@@ -11,82 +11,115 @@
  * @date January 13, 2018
  */
 
+#ifndef DRIVEBASE_C
+#define DRIVEBASE_C
+
 #include "PIDController.c"
+#include "SettleLoop.c"
+#include "Robot.c"
+#include "Odometry.c"
 #include "Ultrasonic.c"
 #include "Arm.c"
+#include "CableGuide.c"
 #include "LEDController.c"
 #include "Constants.h"
-#include "Lighthouse.c"
-
-PID slavePID;
-PID slave2PID;
-PID ultrasonicPID;
-PID turnPID;
-
-float photosensorDefaultValue = 0;
+#include "LightHouse.c"
+#include "ApproachMPC.c"
+#include "Battery.c"
+#include "Profiler.c"
+#include "HAL.h"
 
 /**
  * Initialization code for all of the PID
  * controllers associated with the drivebase.
+ *
+ * @param robot The robot's state.
  */
-void driveInit() {
+void driveInit(Robot &robot) {
 
     // Initialize all of the PID controllers.
-    PIDInit(slavePID, SLAVE_kP, SLAVE_kI, SLAVE_kD, 100, 0, SLAVE_kS, true, SLAVE_kR);
-    PIDReset(slavePID);
+    PIDInit(robot.slavePID, SLAVE_kP, SLAVE_kI, SLAVE_kD, 100, 0, SLAVE_kS, true, SLAVE_kR);
+    PIDReset(robot.slavePID);
 
-    PIDInit(slave2PID, SLAVE_2_kP, SLAVE_2_kI, SLAVE_2_kD, 127, 0, SLAVE_2_kS, true, SLAVE_2_kR);
-    PIDReset(slave2PID);
+    PIDInit(robot.slave2PID, SLAVE_2_kP, SLAVE_2_kI, SLAVE_2_kD, 127, 0, SLAVE_2_kS, true, SLAVE_2_kR);
+    PIDReset(robot.slave2PID);
 
-    PIDInit(ultrasonicPID, ULTRASONIC_kP, ULTRASONIC_kI, ULTRASONIC_kD, 127, 0, ULTRASONIC_kS, true, ULTRASONIC_kR);
-    PIDReset(ultrasonicPID);
+    PIDInit(robot.ultrasonicPID, ULTRASONIC_kP, ULTRASONIC_kI, ULTRASONIC_kD, 127, 0, ULTRASONIC_kS, true, ULTRASONIC_kR);
+    PIDReset(robot.ultrasonicPID);
 
-    PIDInit(turnPID, TURN_kP, TURN_kI, TURN_kD, 1227, 0, TURN_kS, true, TURN_kR);
-    PIDReset(turnPID);
+    PIDInit(robot.turnPID, TURN_kP, TURN_kI, TURN_kD, 1227, 0, TURN_kS, true, TURN_kR);
+    PIDReset(robot.turnPID);
 
-    // Reset encoders.
-    resetMotorEncoder(rightMotor);
-    resetMotorEncoder(leftMotor);
+    // Load the approach gain schedules.
+    scheduleInit(robot.approachSchedule);
+    scheduleInit(robot.slaveSchedule);
+
+    for(int i = 0; i < APPROACH_ROWS; i++) {
+        scheduleAdd(robot.approachSchedule, APPROACH_RANGE[i], APPROACH_kP[i], APPROACH_kI[i], APPROACH_kD[i], APPROACH_kS[i], APPROACH_BIAS[i]);
+        scheduleAdd(robot.slaveSchedule, APPROACH_RANGE[i], APPROACH_SLAVE_kP[i], APPROACH_SLAVE_kI[i], APPROACH_SLAVE_kD[i], APPROACH_SLAVE_kS[i], 0);
+    }
+
+    // Reset encoders and start the pose at the origin.
+    halResetEncoder(rightMotor);
+    halResetEncoder(leftMotor);
+    odometryReset(robot);
 }
 
 /**
  * Resets all encoders and PID loops.
+ *
+ * @param robot The robot's state.
  */
-void driveReset() {
-    resetMotorEncoder(rightMotor);
-    resetMotorEncoder(leftMotor);
-
-    PIDReset(slavePID);
-    PIDReset(slave2PID);
-    PIDReset(ultrasonicPID);
-    PIDReset(turnPID);
+void driveReset(Robot &robot) {
+    resetDriveEncoders(robot);
+
+    PIDReset(robot.slavePID);
+    PIDReset(robot.slave2PID);
+    PIDReset(robot.ultrasonicPID);
+    PIDReset(robot.turnPID);
 }
 
 /**
  * Sets the values for the left and right side
  * of the drivetrain. Written to simplify
- * drive functions.
+ * drive functions. Both sides are compensated
+ * for the battery voltage.
  *
  * @param left  Power level for the left side.
  * @param right Power level for the right side.
  */
 void setRaw(float left, float right) {
-    motor[leftMotor]  = left;
-    motor[rightMotor] = right;
+    setMotor(leftMotor, left);
+    setMotor(rightMotor, right);
 }
 
 /**
  * Stops the motors.
  */
 void stopMotors() {
-    motor[leftMotor]  = 0;
-    motor[rightMotor] = 0;
+    setMotor(leftMotor, 0);
+    setMotor(rightMotor, 0);
+}
+
+/**
+ * Gets the heading of the chassis since the
+ * encoders were last reset. The heading is
+ * measured in the same direction as the
+ * lighthouse angle, so a positive rotate()
+ * gives a negative heading.
+ *
+ * @return The heading of the chassis in degrees.
+ */
+float getChassisHeading() {
+    float ticks = (halGetEncoder(leftMotor) - halGetEncoder(rightMotor)) / 2.0;
+    return (ticks / TICKS_PER_CM2) * 360 / (MATH_PI * DRIVETRAIN_WIDTH);
 }
 
 /**
  * Drives in a perfectly straight line using
  * distance PID and L-R compensation PID.
  *
+ * @param robot The robot's state.
  * @param distance The distance in cm.
  * @param maxSpeed The max allowed speed.
  * @param safeRange The acceptable range around
@@ -94,38 +127,39 @@ void stopMotors() {
  * @param safeThreshold The time required to be
  * inside the safe zone before exiting the
  * function.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the drivetrain jammed.
  */
-void driveStraight(int distance, int maxSpeed, int safeRange, int safeThreshold) {
-
-    driveReset();
+SettleStatus driveStraight(Robot &robot, int distance, int maxSpeed, int safeRange, int safeThreshold) {
 
-    int safeTime = 0;
-    int time     = 0;
-    int dTime    = 0;
+    driveReset(robot);
+    settleInit(robot.driveSettle, safeRange, safeThreshold, 0, DRIVE_SETTLE_VEL, DRIVE_STALL_VEL);
 
     while(true) {
+        profEnter(PROF_DRIVE);
 
-        dTime = nPgmTime - time;
-        time = nPgmTime;
+        float driveError = (distance * TICKS_PER_CM2) - halGetEncoder(rightMotor);
+        float slaveError = (halGetEncoder(rightMotor) - halGetEncoder(leftMotor));
 
-        float driveError = (distance * TICKS_PER_CM2) - getMotorEncoder(rightMotor);
-        float slaveError = (getMotorEncoder(rightMotor) - getMotorEncoder(leftMotor));
-
-        float driveOut = PIDCalculate(slave2PID, driveError);
-        float slaveOut = PIDCalculate(slavePID, slaveError);
+        float driveOut = PIDCalculate(robot.slave2PID, driveError);
+        float slaveOut = PIDCalculate(robot.slavePID, slaveError);
 
         driveOut = clamp(driveOut, maxSpeed);
         slaveOut = clamp(slaveOut, maxSpeed);
 
         setRaw((driveOut + slaveOut), (driveOut - slaveOut));
-        safeTime = abs(driveError) < safeRange ? safeTime + dTime : 0;
 
-        if(safeTime > safeThreshold) {
+        profExit(PROF_DRIVE);
+        execTick(robot.exec, robot.log);
+
+        if(settleUpdate(robot.driveSettle, driveError, driveOut)) {
             break;
         }
     }
 
     stopMotors();
+
+    return robot.driveSettle.status;
 }
 
 /**
@@ -133,6 +167,7 @@ void driveStraight(int distance, int maxSpeed, int safeRange, int safeThreshold)
  * radius and max speed. Radius is measured
  * from the INSIDE wheel.
  *
+ * @param robot The robot's state.
  * @param radius The radius for the arc.
  * @param orientation The ending orientation
  * for the arc.
@@ -142,10 +177,12 @@ void driveStraight(int distance, int maxSpeed, int safeRange, int safeThreshold)
  * @param safeThreshold The time required to be
  * inside the safe zone before exiting the
  * function.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the drivetrain jammed.
  */
-void arcTurn(float radius, float orientation, bool turnRight, int safeRange, int safeThreshold) {
+SettleStatus arcTurn(Robot &robot, float radius, float orientation, bool turnRight, int safeRange, int safeThreshold) {
 
-    driveReset();
+    driveReset(robot);
 
     float insideSet = (2 * MATH_PI * radius) * (orientation / 360) * TICKS_PER_CM2;
     float outsideSet = (2 * MATH_PI * (radius + DRIVETRAIN_WIDTH)) * (orientation / 360) * TICKS_PER_CM2;
@@ -154,25 +191,20 @@ void arcTurn(float radius, float orientation, bool turnRight, int safeRange, int
 
     float outsideError, slaveError;
 
-    int safeTime = 0;
-    int time     = 0;
-    int dTime    = 0;
+    settleInit(robot.driveSettle, safeRange, safeThreshold, 0, DRIVE_SETTLE_VEL, DRIVE_STALL_VEL);
 
     while(true) {
-        dTime = nPgmTime - time;
-        time = nPgmTime;
-
         if(turnRight) {
-            outsideError = outsideSet - getMotorEncoder(leftMotor);
-            slaveError = getMotorEncoder(leftMotor) - getMotorEncoder(rightMotor) * ratio;
+            outsideError = outsideSet - halGetEncoder(leftMotor);
+            slaveError = halGetEncoder(leftMotor) - halGetEncoder(rightMotor) * ratio;
         }
         else {
-            outsideError = outsideSet - getMotorEncoder(rightMotor);
-            slaveError = getMotorEncoder(rightMotor) - getMotorEncoder(leftMotor) * ratio;
+            outsideError = outsideSet - halGetEncoder(rightMotor);
+            slaveError = halGetEncoder(rightMotor) - halGetEncoder(leftMotor) * ratio;
         }
 
-        float driveOut = PIDCalculate(slave2PID, outsideError);
-        float slaveOut = PIDCalculate(slavePID, slaveError);
+        float driveOut = PIDCalculate(robot.slave2PID, outsideError);
+        float slaveOut = PIDCalculate(robot.slavePID, slaveError);
 
         driveOut = clamp(driveOut, 70);
         slaveOut = clamp(slaveOut, 127);
@@ -184,38 +216,246 @@ void arcTurn(float radius, float orientation, bool turnRight, int safeRange, int
             setRaw(((driveOut / ratio) + slaveOut), (driveOut - slaveOut));
         }
 
-        safeTime = abs(outsideError) < safeRange ? safeTime + dTime : 0;
+        execTick(robot.exec, robot.log);
 
-        if(safeTime > safeThreshold) {
+        if(settleUpdate(robot.driveSettle, outsideError, driveOut)) {
             break;
         }
     }
 
     stopMotors();
+
+    return robot.driveSettle.status;
+}
+
+/**
+ * Plans a single arc from the current pose to
+ * the remembered beacon. The arc leaves along
+ * the current heading and runs through the
+ * beacon, so it turns twice the beacon's
+ * bearing by the time it gets there. It stops
+ * ARC_HANDOFF cm of arc short, for the
+ * approach to finish.
+ *
+ * @param robot The robot's state.
+ * @param radius The arc's radius from the
+ * inside wheel, if one was planned.
+ * @param orientation How far the arc turns in
+ * degrees, if one was planned.
+ * @param turnRight Whether the arc turns
+ * right, if one was planned.
+ * @return Whether an arc was planned; there is
+ * none once the beacon is too close for one to
+ * be worth it.
+ */
+bool arcPlan(Robot &robot, float &radius, float &orientation, bool &turnRight) {
+    float dx = robot.beaconX - robot.poseX;
+    float dy = robot.beaconY - robot.poseY;
+    float range = sqrt(dx * dx + dy * dy);
+    float bearing = atan2(dy, dx) - robot.poseTheta;
+
+    while(bearing > MATH_PI) {
+        bearing -= 2 * MATH_PI;
+    }
+    while(bearing < -MATH_PI) {
+        bearing += 2 * MATH_PI;
+    }
+
+    turnRight = bearing < 0;
+    bearing = abs(bearing);
+
+    // Past a quarter turn there is no arc
+    // tangent to the heading worth driving.
+    if(bearing > MATH_PI / 2) {
+        return false;
+    }
+
+    float centre = ARC_MAX_RADIUS;
+    if(range < 2 * ARC_MAX_RADIUS * sin(bearing)) {
+        centre = range / (2 * sin(bearing));
+    }
+
+    float length = (centre < ARC_MAX_RADIUS ? centre * 2 * bearing : range) - ARC_HANDOFF;
+    if(length < ARC_MIN_LENGTH || centre < DRIVETRAIN_WIDTH / 2 + ARC_MIN_RADIUS) {
+        return false;
+    }
+
+    radius = centre - DRIVETRAIN_WIDTH / 2;
+    orientation = length / centre * 180 / MATH_PI;
+    return true;
+}
+
+/**
+ * Places the beacon from the scan's bearing
+ * and the sonar's range, and checks that an
+ * arc can be driven to it. The sonar only
+ * ranges the beacon while it is inside the
+ * cone, so there is no arc outside it.
+ *
+ * @param robot The robot's state.
+ * @param degrees The beacon's bearing from the
+ * chassis' heading, positive to the left.
+ * @return Whether arcDrive() can take the
+ * robot towards the beacon.
+ */
+bool arcStart(Robot &robot, float degrees) {
+    int sonar = halGetSensor(ultrasonic);
+
+    if(abs(degrees) > SONAR_CONE || !sonarValid(sonar)) {
+        return false;
+    }
+
+    odometryUpdate(robot);
+
+    float range = sonar + SONAR_OFFSET;
+    float bearing = robot.poseTheta + degrees * MATH_PI / 180;
+
+    robot.beaconX = robot.poseX + range * cos(bearing);
+    robot.beaconY = robot.poseY + range * sin(bearing);
+    robot.beaconKnown = true;
+    robot.sonarLastOutput = sonar;
+
+    float radius, orientation;
+    bool turnRight;
+    return arcPlan(robot, radius, orientation, turnRight);
+}
+
+/**
+ * Drives an arc towards the beacon placed by
+ * arcStart(), at speed, and hands over without
+ * stopping at the end, so the approach picks
+ * the robot up while it is still moving. The
+ * arc is followed like arcTurn() does it, with
+ * the inside wheel slaved to the outside one
+ * by the arc's ratio. The lighthouse tracks
+ * the beacon the whole way, and if that moves
+ * the beacon by more than ARC_REPLAN cm the
+ * arc is planned again from where the robot
+ * is. At the end of the arc the motors are
+ * left running, so the caller must follow it
+ * with another maneuver. If the drivetrain
+ * stalls or the lighthouse loses the beacon
+ * the motors are stopped.
+ *
+ * @param robot The robot's state.
+ * @param maxSpeed The outside wheel's power.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the drivetrain jammed.
+ */
+SettleStatus arcDrive(Robot &robot, int maxSpeed) {
+    float radius, orientation;
+    bool turnRight = false;
+    bool planned = false;
+    float planX = 0;
+    float planY = 0;
+    float outsideSet = 0;
+    float ratio = 1;
+
+    settleInit(robot.driveSettle, 0, 0, 0, DRIVE_SETTLE_VEL, DRIVE_STALL_VEL);
+
+    // Leave room for the battery compensation, or
+    // on a flat pack both sides clip at full power
+    // and the arc comes out straight.
+    if(maxSpeed * batteryScale() > MAX_SPEED) {
+        maxSpeed = MAX_SPEED / batteryScale();
+    }
+
+    while(true) {
+        profEnter(PROF_ARC_DRIVE);
+
+        int sonar = halGetSensor(ultrasonic);
+        getUltraSonicFiltered(robot);
+        betterAutoTrack(robot, sonar);
+
+        // Let the approach look for the beacon.
+        if(robot.recovery != RECOVER_NONE) {
+            stopMotors();
+            robot.driveSettle.status = SETTLE_DONE;
+            profExit(PROF_ARC_DRIVE);
+            break;
+        }
+
+        float mx = robot.beaconX - planX;
+        float my = robot.beaconY - planY;
+
+        if(!planned || mx * mx + my * my > ARC_REPLAN * ARC_REPLAN) {
+            resetDriveEncoders(robot);
+            PIDReset(robot.slavePID);
+
+            if(!arcPlan(robot, radius, orientation, turnRight)) {
+                robot.driveSettle.status = SETTLE_DONE;
+                profExit(PROF_ARC_DRIVE);
+                break;
+            }
+
+            outsideSet = (2 * MATH_PI * (radius + DRIVETRAIN_WIDTH)) * (orientation / 360) * TICKS_PER_CM2;
+            ratio = (radius + DRIVETRAIN_WIDTH) / radius;
+            planX = robot.beaconX;
+            planY = robot.beaconY;
+            planned = true;
+        }
+
+        odometryUpdate(robot);
+
+        float outside = halGetEncoder(turnRight ? leftMotor : rightMotor);
+        float inside = halGetEncoder(turnRight ? rightMotor : leftMotor);
+        float outsideError = outsideSet - outside;
+
+        if(outsideError <= 0) {
+            robot.driveSettle.status = SETTLE_DONE;
+            profExit(PROF_ARC_DRIVE);
+            break;
+        }
+
+        float slaveOut = clamp(PIDCalculate(robot.slavePID, outside - inside * ratio), maxSpeed);
+
+        if(turnRight) {
+            setRaw((maxSpeed - slaveOut), ((maxSpeed / ratio) + slaveOut));
+        }
+        else {
+            setRaw(((maxSpeed / ratio) + slaveOut), (maxSpeed - slaveOut));
+        }
+
+        profExit(PROF_ARC_DRIVE);
+        execTick(robot.exec, robot.log);
+
+        // The error band is 0, so this only ends the
+        // arc on a stall.
+        if(settleUpdate(robot.driveSettle, outsideError, maxSpeed)) {
+            stopMotors();
+            break;
+        }
+    }
+
+    return robot.driveSettle.status;
 }
 
 /**
  * Approaches the target using the ultrasonic
  * sensor and terminates when the cable has
  * been connected successfully.
+ *
+ * @param robot The robot's state.
  */
-void cableApproach() {
+void cableApproach(Robot &robot) {
 
-    driveReset();
+    driveReset(robot);
 
-    float photosensorDefaultValue = SensorValue[lightSensor];
+    float photosensorDefaultValue = halGetSensor(lightSensor);
     while(!(isCableDetached(photosensorDefaultValue))) {
 
         float driveError = getUltraSonic() - ULTRASONIC_THRESH;
-        float slaveError = (getMotorEncoder(rightMotor) - getMotorEncoder(leftMotor));
+        float slaveError = (halGetEncoder(rightMotor) - halGetEncoder(leftMotor));
 
-        float driveOut = PIDCalculate(ultrasonicPID, driveError);
-        float slaveOut = PIDCalculate(slave2PID, slaveError);
+        float driveOut = PIDCalculate(robot.ultrasonicPID, driveError);
+        float slaveOut = PIDCalculate(robot.slave2PID, slaveError);
 
         driveOut = clamp(driveOut, 40);
         slaveOut = clamp(slaveOut, 40);
 
         setRaw((driveOut + slaveOut), (driveOut - slaveOut));
+
+        execTick(robot.exec, robot.log);
     }
 
     toggleRainbowLED();
@@ -226,40 +466,39 @@ void cableApproach() {
  * Rotates in place for the specified number of
  * degrees.
  *
+ * @param robot The robot's state.
  * @param degrees The number of degrees to turn.
  * @param maxSpeed The max allowed speed during the turn.
  * @param safeRange The acceptable range to around the target to
  * finish the turn in.
  * @param safeThreshold The amount of time neede to be inside
  * the safe zone before exiting the function.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the drivetrain jammed.
  */
-void rotate(float degrees, float maxSpeed, int safeRange, int safeThreshold) {
+SettleStatus rotate(Robot &robot, float degrees, float maxSpeed, int safeRange, int safeThreshold) {
 
-    driveReset();
+    driveReset(robot);
     float arcLength = (MATH_PI * DRIVETRAIN_WIDTH) * (abs(degrees) / 360);
 
-    int safeTime = 0;
-    int time     = 0;
-    int dTime    = 0;
+    settleInit(robot.driveSettle, safeRange, safeThreshold, 0, DRIVE_SETTLE_VEL, DRIVE_STALL_VEL);
 
     while(true) {
-
-        dTime = nPgmTime - time;
-        time = nPgmTime;
+        profEnter(PROF_ROTATE);
 
         float driveError;
 
         if(degrees > 0) {
-            driveError = (arcLength * TICKS_PER_CM2) - getMotorEncoder(rightMotor);
+            driveError = (arcLength * TICKS_PER_CM2) - halGetEncoder(rightMotor);
         }
         else {
-            driveError = (arcLength * TICKS_PER_CM2) + getMotorEncoder(rightMotor);
+            driveError = (arcLength * TICKS_PER_CM2) + halGetEncoder(rightMotor);
         }
 
-        float slaveError = abs(getMotorEncoder(rightMotor)) - abs(getMotorEncoder(leftMotor));
+        float slaveError = abs(halGetEncoder(rightMotor)) - abs(halGetEncoder(leftMotor));
 
-        float driveOut = PIDCalculate(turnPID, driveError);
-        float slaveOut = PIDCalculate(slavePID, slaveError);
+        float driveOut = PIDCalculate(robot.turnPID, driveError);
+        float slaveOut = PIDCalculate(robot.slavePID, slaveError);
 
         driveOut = clamp(driveOut, maxSpeed);
         slaveOut = clamp(slaveOut, maxSpeed);
@@ -271,92 +510,540 @@ void rotate(float degrees, float maxSpeed, int safeRange, int safeThreshold) {
             setRaw((driveOut + slaveOut), -(driveOut - slaveOut));
         }
 
-        safeTime = abs(driveError) < safeRange ? safeTime + dTime : 0;
+        mapUltraSonic(robot);
+
+        profExit(PROF_ROTATE);
+        execTick(robot.exec, robot.log);
 
-        if(safeTime > safeThreshold) {
+        if(settleUpdate(robot.driveSettle, driveError, driveOut)) {
             break;
         }
     }
 
     stopMotors();
+    settleReport(robot.log, robot.driveSettle, LOG_SETTLE_ROTATE);
+
+    return robot.driveSettle.status;
 }
 
-bool realTimeApproach(int maxSpeed) {
-    driveReset();
+typedef enum TurnPhaseEnum {
+    TURN_DRIVE,
+    TURN_BRAKE,
+    TURN_FINE
+} TurnPhase;
 
-    bool turnRight;
-    float slaveError;
-    float ratio = 1;
+/**
+ * Gets how long a fast turn should take with
+ * the current drivetrain model.
+ *
+ * @param robot The robot's state.
+ * @param distance The distance each wheel has
+ * to travel, in ticks.
+ * @param top The wheels' top speed, in
+ * ticks/ms.
+ * @return The predicted time in ms.
+ */
+float turnPredictTime(Robot &robot, float distance, float top) {
+    float a = robot.turnAccel;
+    float d = robot.turnDecel;
+    float peak = sqrt(2 * distance * a * d / (a + d));
 
-    bool wasRight = false;
+    if(peak <= top) {
+        return peak / a + peak / d;
+    }
 
-    // Set the starting value of the cable detachment
-    // sensor
-    photosensorDefaultValue = SensorValue[lightSensor];
+    float cruise = distance - top * top / (2 * a) - top * top / (2 * d);
+    return top / a + top / d + cruise / top;
+}
 
-    while(!(isCableDetached(photosensorDefaultValue))) {
-        float driveError = getUltraSonicFiltered() - ULTRASONIC_THRESH;
+/**
+ * Rotates in place for the specified number of
+ * degrees as fast as the drivetrain allows:
+ * full power until the braking distance (from
+ * the learned deceleration) reaches the
+ * target, full reverse power until the wheels
+ * stop, then the turn PID for whatever is
+ * left. The acceleration and deceleration
+ * seen on every turn are blended into the
+ * model for the next one.
+ *
+ * @param robot The robot's state.
+ * @param degrees The number of degrees to turn.
+ * @param maxSpeed The max allowed speed during the turn.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the drivetrain jammed.
+ */
+SettleStatus rotateFast(Robot &robot, float degrees, float maxSpeed) {
+
+    driveReset(robot);
+    float dir = sign(degrees);
+    float ticksPerDeg = (MATH_PI * DRIVETRAIN_WIDTH) / 360 * TICKS_PER_CM2;
+    float target = abs(degrees) * ticksPerDeg;
+    float top = maxSpeed / MAX_SPEED * DRIVE_TOP_SPEED * TICKS_PER_CM2 / 1000;
+
+    settleInit(robot.driveSettle, TURN_FINE_DEG * ticksPerDeg, SETTLE_FAST_DWELL, 0, DRIVE_SETTLE_VEL, DRIVE_STALL_VEL);
+
+    logInfo(robot, LOG_TURN_PLAN, degrees, turnPredictTime(robot, target, top), 0);
 
-        if(driveError < 40) {
-            L_SENSOR_DIFF = -100;
+    TurnPhase phase = TURN_DRIVE;
+    long start = timeMicros();
+    float brakeError = 0;
+    float brakeVelocity = 0;
+
+    while(true) {
+        profEnter(PROF_ROTATE_FAST);
+
+        float turned = dir * (halGetEncoder(rightMotor) - halGetEncoder(leftMotor)) / 2;
+        float driveError = target - turned;
+        float driveOut;
+
+        // The settle loop's error rate is the average
+        // over the last tick, so it lags the wheels by
+        // half a tick. Push it forward with the model.
+        float velocity = -robot.driveSettle.errorRate;
+
+        if(phase == TURN_DRIVE) {
+            driveOut = maxSpeed;
+            velocity = clamp2(velocity + robot.turnAccel * EXEC_PERIOD / 2, 0, top);
+
+            // Brake a tick early, since the next chance
+            // to is a whole tick away.
+            if(driveError <= velocity * velocity / (2 * robot.turnDecel) + velocity * EXEC_PERIOD) {
+                phase = TURN_BRAKE;
+                brakeError = driveError;
+                brakeVelocity = velocity;
+
+                // Only a turn that was still speeding up
+                // says anything about the acceleration.
+                float elapsed = (timeMicros() - start) / 1000.0;
+                if(velocity < 0.9 * top && elapsed > 0) {
+                    robot.turnAccel += TURN_LEARN_RATE * (velocity / elapsed - robot.turnAccel);
+                }
+            }
         }
-        if(driveError < 20) {
-            L_SENSOR_DIFF = -200;
+
+        if(phase == TURN_BRAKE) {
+            driveOut = -maxSpeed;
+            velocity -= robot.turnDecel * EXEC_PERIOD / 2;
+
+            if(velocity <= TURN_BRAKE_VEL) {
+                phase = TURN_FINE;
+                PIDReset(robot.turnPID);
+
+                float stopped = brakeError - driveError;
+                if(stopped > 0 && brakeVelocity > 0) {
+                    robot.turnDecel += TURN_LEARN_RATE * (brakeVelocity * brakeVelocity / (2 * stopped) - robot.turnDecel);
+                }
+            }
+        }
+
+        if(phase == TURN_FINE) {
+            driveOut = clamp(PIDCalculate(robot.turnPID, driveError), maxSpeed);
         }
 
-        turnRight = SensorValue[towerPot] > POT_TRACKING_THRESH;
+        float slaveError = abs(halGetEncoder(rightMotor)) - abs(halGetEncoder(leftMotor));
+        float slaveOut = clamp(PIDCalculate(robot.slavePID, slaveError), maxSpeed);
 
-        if(turnRight && !wasRight) {
-            resetMotorEncoder(rightMotor);
-            resetMotorEncoder(leftMotor);
-            PIDReset(slavePID);
-            wasRight = true;
+        setRaw(-dir * (driveOut + slaveOut), dir * (driveOut - slaveOut));
+
+        mapUltraSonic(robot);
+
+        profExit(PROF_ROTATE_FAST);
+        execTick(robot.exec, robot.log);
+
+        if(settleUpdate(robot.driveSettle, driveError, driveOut)) {
+            break;
+        }
+    }
+
+    stopMotors();
+
+    logInfo(robot, LOG_TURN_DONE, (timeMicros() - start) / 1000, robot.turnAccel, robot.turnDecel);
+
+    return robot.driveSettle.status;
+}
+
+/**
+ * Scans for the beacon while the chassis is
+ * already turning towards it. Every sample is
+ * stored as a world bearing (lighthouse angle
+ * plus chassis heading), so the chassis can
+ * start rotating towards the half of the field
+ * holding the strongest reading as soon as it
+ * is confident, instead of waiting for the
+ * sweep to finish. When the sweep ends posInDegs
+ * holds the bearing relative to the chassis'
+ * current heading, so rotate() only has to
+ * finish the remainder of the turn.
+ *
+ * @param robot The robot's state.
+ * @param degrees The angle to sweep the lighthouse to.
+ * @param maxSpeed The max allowed lighthouse speed.
+ * @param safeRange The range tollerance.
+ * @param safeThreshold The time needed to be
+ * in the safe zone before finishing.
+ * @param turnSpeed The max allowed chassis speed
+ * during the sweep.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the lighthouse jammed.
+ */
+SettleStatus scanWhileRotating(Robot &robot, float degrees, int maxSpeed, int safeRange, int safeThreshold, int turnSpeed) {
+    PIDReset(robot.lightPID);
+    driveReset(robot);
+
+    float bestBearing = 180;
+    float heading = 0;
+
+    robot.highestValue = 0;
+
+    settleInit(robot.towerSettle, safeRange, safeThreshold, 0, TOWER_SETTLE_VEL, TOWER_STALL_VEL);
+
+    while(true) {
+        profEnter(PROF_SCAN_PASS);
+
+        float angle = towerAngle(robot);
+        float error = (degrees - angle) * TICKS_PER_DEG;
+        float out = PIDCalculate(robot.lightPID, error);
+
+        out = clamp(out, maxSpeed);
+        setMotor(towerMotor, out);
+
+        heading = getChassisHeading();
+        mapUltraSonic(robot);
+
+        float val = getLeftLight(robot);
+        if(val > robot.highestValue) {
+            robot.highestValue = val;
+            robot.pos = halGetSensor(towerPot);
+            bestBearing = angle - SCAN_SENSOR_OFFSET + heading;
         }
-        else if(!turnRight && wasRight) {
-            resetMotorEncoder(rightMotor);
-            resetMotorEncoder(leftMotor);
-            PIDReset(slavePID);
-            wasRight = false;
+        lightRangeDark(robot.lightRange, val);
+
+        // Only commit the chassis to a direction once the
+        // best reading actually looks like the beacon.
+        if(robot.highestValue > BEACON_FOUND_THRESH) {
+            float turnError = (180 - bestBearing + heading) * (MATH_PI * DRIVETRAIN_WIDTH / 360) * TICKS_PER_CM2;
+            float turnOut = clamp(PIDCalculate(robot.turnPID, turnError), turnSpeed);
+            setRaw(-turnOut, turnOut);
         }
 
-        ratio = (TRACKING_TURN_SENS + (abs(SensorValue[towerPot] - POT_TRACKING_THRESH))) / TRACKING_TURN_SENS;
-        ratio = sqrt(ratio);
+        profExit(PROF_SCAN_PASS);
+        execTick(robot.exec, robot.log);
 
-        betterAutoTrack();
+        if(settleUpdate(robot.towerSettle, error, out)) {
+            break;
+        }
+    }
 
-        if(turnRight) {
-            slaveError = getMotorEncoder(leftMotor) - getMotorEncoder(rightMotor) * ratio;
+    stopMotors();
+    setMotor(towerMotor, 0);
+
+    robot.posInDegs = bestBearing - getChassisHeading();
+
+    return robot.towerSettle.status;
+}
+
+/**
+ * Checks the arc the approach is about to
+ * drive against the occupancy grid. If
+ * something is in the way, the arc is swapped
+ * for the nearest steering that is clear.
+ * Steering is expressed the same way
+ * realTimeApproach does it: a turn direction
+ * and an outside/inside wheel ratio.
+ *
+ * @param robot The robot's state.
+ * @param turnRight Whether to turn right, updated
+ * if the arc is changed.
+ * @param ratio The wheel ratio, updated if the
+ * arc is changed.
+ * @param range The distance to the beacon in cm.
+ */
+void avoidObstacles(Robot &robot, bool &turnRight, float &ratio, float range) {
+    float length = range - BEACON_CLEARANCE;
+
+    if(length <= 0 || gridOccupied(robot.grid) == 0) {
+        return;
+    }
+
+    float steer = turnRight ? ratio - 1 : 1 - ratio;
+
+    // Try 0, +1, -1, +2, -2... steps away from the
+    // steering the tracker asked for.
+    for(int i = 0; i <= 2 * STEER_CANDIDATES; i++) {
+        float candidate = steer + STEER_STEP * ((i + 1) / 2) * (i % 2 == 1 ? 1 : -1);
+        float candidateRatio = 1 + abs(candidate);
+        float curvature = 2 * (candidateRatio - 1) / (DRIVETRAIN_WIDTH * (candidateRatio + 1));
+
+        if(candidate > 0) {
+            curvature = -curvature;
         }
-        else {
-            slaveError = getMotorEncoder(rightMotor) - getMotorEncoder(leftMotor) * ratio;
+
+        if(gridArcClear(robot.grid, robot.poseX, robot.poseY, robot.poseTheta, curvature, length, PATH_CLEARANCE)) {
+            turnRight = candidate > 0;
+            ratio = candidateRatio;
+            return;
         }
+    }
+}
 
-        // Calculate the motor outputs using the PID controllers.
-        float driveOut = PIDCalculate(ultrasonicPID, driveError);
-        float slaveOut = PIDCalculate(slavePID, slaveError);
+/**
+ * Gets the power the approach can hold at a
+ * range and still slow down for the beacon.
+ * The stopping distance goes with the square
+ * of the speed, so the power falls off with
+ * the square root of the range, from maxSpeed
+ * at APPROACH_PLAN_RANGE to nothing at the
+ * beacon.
+ *
+ * @param range The range to the beacon in cm.
+ * @param maxSpeed The max allowed speed.
+ * @return The power to hold.
+ */
+float approachPlanPower(float range, int maxSpeed) {
+    return maxSpeed * sqrt(clamp2(range / APPROACH_PLAN_RANGE, 0, 1));
+}
 
-        // Limit the output of the PID controllers to the
-        // specified max speed.
-        driveOut = clamp(driveOut, maxSpeed);
-        slaveOut = clamp(slaveOut, maxSpeed);
+/**
+ * Runs one tick of the approach. The sensors
+ * are read once at the start, then the
+ * steering and lighthouse tracking are
+ * updated, the controllers run, and finally
+ * both sides are driven. The drive uses the
+ * approach planner when USE_MPC_APPROACH is
+ * set and the beacon's position is known.
+ * Otherwise the PID controllers drive, with
+ * the arc steered clear of the map's
+ * obstacles.
+ *
+ * @param robot The robot's state.
+ * @param maxSpeed The max allowed speed.
+ * @param wasRight Whether the last tick turned
+ * right, updated for the next tick.
+ */
+void approachStep(Robot &robot, int maxSpeed, bool &wasRight) {
+    profEnter(PROF_APPROACH_STEP);
+
+    // Snapshot the sensors, so every stage of the
+    // tick works from the same readings. The
+    // lighthouse tracker reads its own photosensors.
+    // The head's angle goes first, since the range
+    // checks the sonar is pointing where it is.
+    int pot = halGetSensor(towerPot);
+    towerAngleFrom(robot, pot);
+    int sonar = halGetSensor(ultrasonic);
+    float range;
+    bool onBeacon = getBeaconRange(robot, sonar, range);
+    odometryUpdate(robot);
+    long leftTicks = halGetEncoder(leftMotor);
+    long rightTicks = halGetEncoder(rightMotor);
+
+    float driveError = range - ULTRASONIC_THRESH;
+
+    // Pick the gains and sensor bias for the current range.
+    robot.lSensorDiff = scheduleApply(robot.approachSchedule, robot.ultrasonicPID, driveError);
+    scheduleApply(robot.slaveSchedule, robot.slavePID, driveError);
+
+    bool turnRight = pot > POT_TRACKING_THRESH;
+
+    float ratio = (TRACKING_TURN_SENS + (abs(pot - POT_TRACKING_THRESH))) / TRACKING_TURN_SENS;
+    ratio = sqrt(ratio);
+
+    betterAutoTrack(robot, sonar);
+
+    logDebugEvery(robot, 250, LOG_APPROACH, driveError, ratio, turnRight);
+
+    // Hold still while the lighthouse looks for the
+    // beacon instead of driving off blind.
+    if(robot.recovery != RECOVER_NONE) {
+        stopMotors();
+        PIDReset(robot.ultrasonicPID);
+        PIDReset(robot.slavePID);
+        profExit(PROF_APPROACH_STEP);
+        return;
+    }
 
-        // Apply the power to the motors.
-        if(turnRight) {
-            setRaw((driveOut - slaveOut), ((driveOut / ratio) + slaveOut));
+    // Calculate the motor outputs using the PID controllers.
+    float driveOut = PIDCalculate(robot.ultrasonicPID, driveError);
+    driveOut = clamp(driveOut, maxSpeed);
+
+    // The D term brakes on every cm the range
+    // closes, so on its own the range controller
+    // creeps in from far out. Once the range is
+    // known to be to the beacon, hold at least the
+    // speed the robot can still stop from by the
+    // time it gets there; the controller has the
+    // last few cm to itself.
+    if(onBeacon) {
+        float plan = approachPlanPower(driveError, maxSpeed);
+        if(driveOut < plan) {
+            driveOut = plan;
         }
-        else {
-            setRaw(((driveOut / ratio) + slaveOut), (driveOut - slaveOut));
+    }
+
+    // Let the planner steer while it can. Its speed
+    // follows the range controller's output, but
+    // doesn't crawl the last few cm like the PID.
+    if(USE_MPC_APPROACH) {
+        float left, right;
+        long start = timeMicros();
+        profEnter(PROF_MPC_PLAN);
+        bool planned = mpcPlan(robot, clamp2(driveOut, MPC_MIN_POWER, maxSpeed), left, right);
+        profExit(PROF_MPC_PLAN);
+        long took = timeMicros() - start;
+
+        if(took > MPC_TICK_BUDGET) {
+            logWarnEvery(robot, 1000, LOG_APPROACH_PLAN_SLOW, took, 0, 0);
+        }
+
+        if(planned) {
+            PIDReset(robot.slavePID);
+            setRaw(left, right);
+            profExit(PROF_APPROACH_STEP);
+            return;
         }
     }
-    return true;
+
+    // Swap the arc for a clear one if the map shows
+    // something between us and the beacon. The
+    // planner checks the map itself, so this is only
+    // needed when the PIDs steer.
+    avoidObstacles(robot, turnRight, ratio, driveError);
+
+    if(turnRight != wasRight) {
+        resetDriveEncoders(robot);
+        PIDReset(robot.slavePID);
+        leftTicks = 0;
+        rightTicks = 0;
+        wasRight = turnRight;
+    }
+
+    float slaveError;
+    if(turnRight) {
+        slaveError = leftTicks - rightTicks * ratio;
+    }
+    else {
+        slaveError = rightTicks - leftTicks * ratio;
+    }
+
+    float slaveOut = PIDCalculate(robot.slavePID, slaveError);
+
+    // Limit the output of the PID controllers to the
+    // specified max speed.
+    slaveOut = clamp(slaveOut, maxSpeed);
+
+    // Apply the power to the motors.
+    if(turnRight) {
+        setRaw((driveOut - slaveOut), ((driveOut / ratio) + slaveOut));
+    }
+    else {
+        setRaw(((driveOut / ratio) + slaveOut), (driveOut - slaveOut));
+    }
+
+    profExit(PROF_APPROACH_STEP);
+}
+
+bool realTimeApproach(Robot &robot, int maxSpeed) {
+    driveReset(robot);
+
+    bool wasRight = false;
+
+    // Set the starting value of the cable detachment
+    // sensor
+    robot.photosensorDefaultValue = halGetSensor(lightSensor);
+
+    robot.recovery = RECOVER_NONE;
+
+    bool success = true;
+
+    while(!(isCableDetached(robot.photosensorDefaultValue))) {
+        approachStep(robot, maxSpeed, wasRight);
+        cableGuideStep(robot);
+        execTick(robot.exec, robot.log);
+
+        // The beacon is gone for good, so give up and
+        // let the state machine scan for it again.
+        if(robot.recovery == RECOVER_FAILED) {
+            logWarn(robot, LOG_APPROACH_LOST, 0, 0, 0);
+            robot.recovery = RECOVER_NONE;
+            stopMotors();
+            success = false;
+            break;
+        }
+    }
+
+    // The other maneuvers share the slave controller.
+    PIDSetGains(robot.slavePID, SLAVE_kP, SLAVE_kI, SLAVE_kD, SLAVE_kS);
+    return success;
+}
+
+/**
+ * Starts backing away from the beacon after
+ * connecting the cable. Call quikBakStep()
+ * every tick until it returns true; other
+ * maneuvers that don't use the drivetrain can
+ * run in the same loop.
+ *
+ * @param robot The robot's state.
+ */
+void quikBakStart(Robot &robot) {
+    odometryUpdate(robot);
+
+    robot.backStartX = robot.poseX;
+    robot.backStartY = robot.poseY;
+    robot.backStartTime = timeMicros();
+    robot.backing = true;
+
+    setRaw(-QUIKBAK_SPEED, -QUIKBAK_SPEED);
+}
+
+/**
+ * Runs one tick of backing away. Power is cut
+ * as soon as the distance covered, plus what
+ * the robot will coast at its current speed,
+ * reaches QUIKBAK_DISTANCE, so the robot comes
+ * to rest there without waiting for it.
+ *
+ * @param robot The robot's state.
+ * @return Whether the robot has finished
+ * backing away.
+ */
+bool quikBakStep(Robot &robot) {
+    if(!robot.backing) {
+        return true;
+    }
+
+    odometryUpdate(robot);
+
+    float dx = robot.poseX - robot.backStartX;
+    float dy = robot.poseY - robot.backStartY;
+    float coast = abs(robot.leftSpeed + robot.rightSpeed) / 2 * MPC_WHEEL_TAU;
+
+    float distance = sqrt(dx * dx + dy * dy);
+    long elapsed = (timeMicros() - robot.backStartTime) / 1000;
+
+    if(distance + coast >= QUIKBAK_DISTANCE || elapsed > QUIKBAK_TIMEOUT) {
+        stopMotors();
+        robot.backing = false;
+        logInfo(robot, LOG_BACK, distance, elapsed, 0);
+    }
+
+    return !robot.backing;
 }
 
 /**
  * Backs away from the beacon quickly after
- * connecting the cable.
+ * connecting the cable, returning as soon as
+ * the robot has covered QUIKBAK_DISTANCE.
+ *
+ * @param robot The robot's state.
  */
-void quikBak() {
-    setRaw(-100, -100);
-    wait1Msec(175);
-    stopMotors();
+void quikBak(Robot &robot) {
+    quikBakStart(robot);
+
+    while(!quikBakStep(robot)) {
+        execTick(robot.exec, robot.log);
+    }
 }
+
+#endif
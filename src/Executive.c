@@ -0,0 +1,155 @@
+/**
+ * This class contains the fixed-period
+ * executive that paces every control loop on
+ * the robot. Each maneuver runs one pass of
+ * its loop (read the sensors, update its
+ * state, run its controllers, set the motors)
+ * and then hands over to execTick(), which
+ * waits for the next tick. The ticks sit on a
+ * fixed grid, so a slow pass doesn't push the
+ * following ones back.
+ *
+ * A tick with LOG_FLUSH_SLACK to spare once
+ * its pass is done writes out the oldest
+ * pending log entry, so the log keeps up with
+ * long maneuvers.
+ *
+ * A pass that runs past the end of its tick
+ * is an overrun. Every overrun is counted and
+ * the last few are kept with their time and
+ * how late they were; execReport() writes the
+ * statistics out.
+ *
+ * @author Jayden Chan
+ * @date April 18, 2018
+ */
+
+#ifndef EXECUTIVE_C
+#define EXECUTIVE_C
+
+#include "Constants.h"
+#include "Timebase.c"
+#include "Profiler.c"
+#include "Log.c"
+
+typedef struct {
+    int period;
+    long nextTick;
+    long lastTick;
+
+    long ticks;
+    long skipped;
+
+    // Time spent working in each tick, in us.
+    long busyTotal;
+    long busyMax;
+
+    // Overruns, newest at overrunHead - 1. Only
+    // the last few are kept; the count covers the
+    // rest.
+    int overruns;
+    long overrunTime[EXEC_OVERRUN_LOG];
+    short overrunLate[EXEC_OVERRUN_LOG];
+    short overrunHead;
+} Executive;
+
+/**
+ * Starts the executive's tick grid at the
+ * current time and clears its statistics.
+ *
+ * @param exec The executive to initialize.
+ * @param period The tick period in ms.
+ */
+void execInit(Executive &exec, int period) {
+    exec.period = period;
+    exec.lastTick = timeMicros();
+    exec.nextTick = exec.lastTick + period * 1000;
+
+    exec.ticks = 0;
+    exec.skipped = 0;
+    exec.busyTotal = 0;
+    exec.busyMax = 0;
+
+    exec.overruns = 0;
+    exec.overrunHead = 0;
+}
+
+/**
+ * Ends the current pass of a control loop and
+ * waits for the start of the next tick. If the
+ * pass ran past its tick, the overrun is
+ * recorded and the next pass starts straight
+ * away, finishing on the next tick that is
+ * still in the future.
+ *
+ * @param exec The executive to wait on.
+ * @param log The log to write out with any
+ * time left over.
+ * @return Whether this pass overran.
+ */
+bool execTick(Executive &exec, Log &log) {
+    long now = timeMicros();
+    long busy = now - exec.lastTick;
+
+    exec.ticks++;
+    exec.busyTotal += busy;
+    if(busy > exec.busyMax) {
+        exec.busyMax = busy;
+    }
+
+    bool overran = (long)(now - exec.nextTick) > 0;
+
+    if(overran) {
+        exec.overrunTime[exec.overrunHead] = timeMillis();
+        exec.overrunLate[exec.overrunHead] = (now - exec.nextTick) / 1000;
+        exec.overrunHead = (exec.overrunHead + 1) % EXEC_OVERRUN_LOG;
+        exec.overruns++;
+
+        // Start the next pass right away, but drop
+        // any ticks that were missed completely rather
+        // than running them back to back to catch up.
+        exec.nextTick += exec.period * 1000;
+        while((long)(now - exec.nextTick) >= 0) {
+            exec.nextTick += exec.period * 1000;
+            exec.skipped++;
+        }
+        exec.lastTick = now;
+    }
+    else {
+        if(log.count > 0 && (long)(exec.nextTick - now) >= LOG_FLUSH_SLACK * 1000) {
+            logFlushOne(log);
+            now = timeMicros();
+        }
+
+        // Round up, so the next pass never starts
+        // before its tick.
+        long left = exec.nextTick - now;
+        wait1Msec(left > 0 ? (left + 999) / 1000 : 0);
+        exec.lastTick = timeMicros();
+        profPoll(exec.lastTick);
+        exec.nextTick += exec.period * 1000;
+    }
+
+    return overran;
+}
+
+/**
+ * Writes the executive's tick statistics and
+ * the most recent overruns to the debug
+ * stream.
+ *
+ * @param exec The executive to report.
+ */
+void execReport(Executive &exec) {
+    writeDebugStreamLine("exec: %d ms ticks, %d run, %d overruns, %d skipped, busy %d us avg, %d us max",
+        exec.period, (int)exec.ticks, exec.overruns, (int)exec.skipped,
+        exec.ticks > 0 ? (int)(exec.busyTotal / exec.ticks) : 0, (int)exec.busyMax);
+
+    int logged = exec.overruns < EXEC_OVERRUN_LOG ? exec.overruns : EXEC_OVERRUN_LOG;
+    for(int i = 0; i < logged; i++) {
+        int slot = (exec.overrunHead - logged + i + EXEC_OVERRUN_LOG) % EXEC_OVERRUN_LOG;
+        writeDebugStreamLine("exec: overrun at %d ms, %d ms late", (int)exec.overrunTime[slot], exec.overrunLate[slot]);
+    }
+}
+
+#endif
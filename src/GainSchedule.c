@@ -0,0 +1,104 @@
+/**
+ * This class contains the gain scheduler used
+ * by the approach controllers. A schedule is a
+ * table of range breakpoints, each with its
+ * own PID gains, slew rate and photosensor
+ * bias. Every tick the gains for the current
+ * range are linearly interpolated between the
+ * two nearest breakpoints, so a controller
+ * can be aggressive far from the beacon and
+ * gentle close to it.
+ *
+ * @author Jayden Chan
+ * @date April 9, 2018
+ */
+
+#ifndef GAINSCHEDULE_C
+#define GAINSCHEDULE_C
+
+#include "Constants.h"
+#include "PIDController.c"
+
+typedef struct {
+    int size;
+    float range[GAIN_SCHEDULE_MAX];
+    float P[GAIN_SCHEDULE_MAX];
+    float I[GAIN_SCHEDULE_MAX];
+    float D[GAIN_SCHEDULE_MAX];
+    float slewRate[GAIN_SCHEDULE_MAX];
+    float bias[GAIN_SCHEDULE_MAX];
+} GainSchedule;
+
+/**
+ * Empties the schedule.
+ *
+ * @param schedule The schedule to clear.
+ */
+void scheduleInit(GainSchedule &schedule) {
+    schedule.size = 0;
+}
+
+/**
+ * Adds a breakpoint to the end of the schedule.
+ * Breakpoints must be added in order of
+ * increasing range.
+ *
+ * @param schedule The schedule to add to.
+ * @param range The range for this breakpoint.
+ * @param kP The P value at this range.
+ * @param kI The I value at this range.
+ * @param kD The D value at this range.
+ * @param slewRate The slew rate at this range.
+ * @param bias The sensor bias at this range.
+ */
+void scheduleAdd(GainSchedule &schedule, float range, float kP, float kI, float kD, float slewRate, float bias) {
+    if(schedule.size >= GAIN_SCHEDULE_MAX) {
+        return;
+    }
+
+    int i = schedule.size;
+    schedule.range[i] = range;
+    schedule.P[i] = kP;
+    schedule.I[i] = kI;
+    schedule.D[i] = kD;
+    schedule.slewRate[i] = slewRate;
+    schedule.bias[i] = bias;
+    schedule.size++;
+}
+
+/**
+ * Loads the gains for the given range into a
+ * PID controller. Ranges outside the table
+ * use the first or last breakpoint.
+ *
+ * @param schedule The schedule to use.
+ * @param pid The controller to update.
+ * @param range The current range.
+ * @return The interpolated sensor bias.
+ */
+float scheduleApply(GainSchedule &schedule, PID &pid, float range) {
+    if(schedule.size == 0) {
+        return 0;
+    }
+
+    int hi = 0;
+    while(hi < schedule.size - 1 && schedule.range[hi] < range) {
+        hi++;
+    }
+    int lo = hi > 0 ? hi - 1 : 0;
+
+    float t = 0;
+    if(hi != lo) {
+        t = clamp2((range - schedule.range[lo]) / (schedule.range[hi] - schedule.range[lo]), 0, 1);
+    }
+
+    PIDSetGains(pid,
+        schedule.P[lo] + t * (schedule.P[hi] - schedule.P[lo]),
+        schedule.I[lo] + t * (schedule.I[hi] - schedule.I[lo]),
+        schedule.D[lo] + t * (schedule.D[hi] - schedule.D[lo]),
+        schedule.slewRate[lo] + t * (schedule.slewRate[hi] - schedule.slewRate[lo]));
+
+    return schedule.bias[lo] + t * (schedule.bias[hi] - schedule.bias[lo]);
+}
+
+#endif
@@ -0,0 +1,116 @@
+//======================================
+// Hardware abstraction layer. Every read
+// or write of a sensor, motor or encoder
+// goes through these macros so that the
+// same control code can run on the robot,
+// in the Linux simulator or against a
+// recorded trace.
+//
+// The backend is picked at compile time:
+//   (default)   ROBOTC hardware
+//   HAL_SIM     Linux simulator (sim/)
+//   HAL_REPLAY  Trace replay    (sim/)
+//
+// The ROBOTC backend expands straight to
+// the built-in arrays so the robot build
+// pays nothing for the abstraction.
+//
+// Encoder reads go over I2C on the robot, so
+// with PROFILE_ENABLED every read is counted
+// and timed by the profiler (see Profiler.c).
+//
+// HAL_TIMER_RESOLUTION is the resolution of
+// halGetMicros() in microseconds. Only the
+// host backends have a sub-millisecond
+// clock. ROBOTC gives user code no timer
+// finer than nPgmTime on the Cortex, so on
+// the robot halGetMicros() is the 1 ms clock
+// in microsecond units. On the Cortex a long
+// holds about 35 minutes of
+// microseconds, so the clock wraps; compare
+// times by their difference (see
+// Timebase.c), never directly.
+// halGetMillis() is the same clock in
+// milliseconds, which doesn't wrap in a run.
+// halGetBattery() is the main battery's
+// voltage in millivolts.
+//
+// halSetUpPorts() gives the robot's ports
+// whatever the variant needs beyond the
+// wizard's port map (see RobotConfig.h).
+// Call it first thing.
+//======================================
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "RobotConfig.h"
+
+#if defined(HAL_SIM)
+
+#include "../sim/Simulator.h"
+
+#define halGetSensor(port)          simGetSensor(port)
+#define halSetSensor(port, value)   simSetSensor(port, value)
+#define halGetMotor(port)           simGetMotor(port)
+#define halSetMotor(port, value)    simSetMotor(port, value)
+#define halReadEncoder(port)        simGetEncoder(port)
+#define halResetEncoder(port)       simResetEncoder(port)
+#define halGetMicros()              simGetMicros()
+#define halGetMillis()              (simGetMicros() / 1000)
+#define halGetBattery()             simGetBattery()
+#define halSetUpPorts()
+#define HAL_TIMER_RESOLUTION        1
+
+#elif defined(HAL_REPLAY)
+
+#include "../sim/Replay.h"
+
+#define halGetSensor(port)          replayGetSensor(port)
+#define halSetSensor(port, value)   replaySetSensor(port, value)
+#define halGetMotor(port)           replayGetMotor(port)
+#define halSetMotor(port, value)    replaySetMotor(port, value)
+#define halReadEncoder(port)        replayGetEncoder(port)
+#define halResetEncoder(port)       replayResetEncoder(port)
+#define halGetMicros()              replayGetMicros()
+#define halGetMillis()              (replayGetMicros() / 1000)
+#define halGetBattery()             replayGetBattery()
+#define halSetUpPorts()
+#define HAL_TIMER_RESOLUTION        1
+
+#else
+
+#define halGetSensor(port)          SensorValue[port]
+#define halSetSensor(port, value)   SensorValue[port] = (value)
+#define halGetMotor(port)           motor[port]
+#define halSetMotor(port, value)    motor[port] = (value)
+#ifdef CFG_LEFT_ENCODER
+#define halReadEncoder(port)        ((port) == leftMotor ? SensorValue[CFG_LEFT_ENCODER] : -SensorValue[CFG_RIGHT_ENCODER])
+#define halResetEncoder(port)       SensorValue[(port) == leftMotor ? CFG_LEFT_ENCODER : CFG_RIGHT_ENCODER] = 0
+#else
+#define halReadEncoder(port)        getMotorEncoder(port)
+#define halResetEncoder(port)       resetMotorEncoder(port)
+#endif
+// Still 1 ms steps; see the note at the top.
+#define halGetMicros()              (nPgmTime * 1000)
+#define halGetMillis()              nPgmTime
+#define halGetBattery()             nAvgBatteryLevel
+#define halSetUpPorts()             CFG_SET_UP_PORTS()
+#define HAL_TIMER_RESOLUTION        1000
+
+#endif
+
+// Override on the command line to build the
+// profiler in.
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 0
+#endif
+
+#if PROFILE_ENABLED
+long profGetEncoder(tMotor port);
+#define halGetEncoder(port)         profGetEncoder(port)
+#else
+#define halGetEncoder(port)         halReadEncoder(port)
+#endif
+
+#endif
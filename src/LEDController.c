@@ -7,15 +7,20 @@
  * @date March 3, 2018
  */
 
+#ifndef LEDCONTROLLER_C
+#define LEDCONTROLLER_C
+
+#include "HAL.h"
+
 /**
  * Toggles the red LED on or off.
  */
 void toggleRedLED() {
-    if(SensorValue[LED1]) {
-        SensorValue[LED1] = 0;
+    if(halGetSensor(LED1)) {
+        halSetSensor(LED1, 0);
     }
     else {
-        SensorValue[LED1] = 1;
+        halSetSensor(LED1, 1);
     }
 }
 
@@ -23,11 +28,11 @@ void toggleRedLED() {
  * Toggles the rainbow LED on or off.
  */
 void toggleRainbowLED() {
-    if(SensorValue[LED2]) {
-        SensorValue[LED2] = 0;
+    if(halGetSensor(LED2)) {
+        halSetSensor(LED2, 0);
     }
     else {
-        SensorValue[LED2] = 1;
+        halSetSensor(LED2, 1);
     }
 }
 
@@ -37,6 +42,8 @@ void toggleRainbowLED() {
  * the robot.
  */
 void turnOffAllLED() {
-    SensorValue[LED1] = 0;
-    SensorValue[LED2] = 0;
+    halSetSensor(LED1, 0);
+    halSetSensor(LED2, 0);
 }
+
+#endif
@@ -10,110 +10,148 @@
  * @date March 4, 2018
  */
 
+#ifndef LIGHTHOUSE_C
+#define LIGHTHOUSE_C
+
 #include "Constants.h"
 #include "PIDController.c"
+#include "SettleLoop.c"
+#include "Robot.c"
+#include "Odometry.c"
+#include "TowerAngle.c"
 #include "Utils.c"
 #include "DriveBase.c"
-
-PID lightPID;
-
-int pos = 0;
-int posInDegs = 0;
-float averageOne[3];
-float averageTwo[3];
-int numAverages = 3;
-bool recovering = false;
-float lastDir = 1;
-int timeout = 0;
-
-float highestValue = 0;
+#include "Battery.c"
+#include "Profiler.c"
+#include "HAL.h"
 
 /**
  * Gets the value of the left light sensor
  * after averaging the last few values.
  *
+ * @param robot The robot's state.
  * @return The value of the sensor.
  */
-float getLeftLight() {
-    for(int i = numAverages-1; i > 0; i--) {
-        averageOne[i] = averageOne[i-1];
+float getLeftLight(Robot &robot) {
+    profEnter(PROF_LEFT_LIGHT);
+
+    for(int i = LIGHT_AVERAGES-1; i > 0; i--) {
+        robot.averageOne[i] = robot.averageOne[i-1];
     }
-    averageOne[0] = SensorValue[lightSensor2];
+    robot.averageOne[0] = halGetSensor(lightSensor2);
 
     float sum = 0;
-    for(int i = 0; i < numAverages; i++) {
-        sum += averageOne[i];
+    for(int i = 0; i < LIGHT_AVERAGES; i++) {
+        sum += robot.averageOne[i];
     }
 
-    return sum / numAverages;
+    profExit(PROF_LEFT_LIGHT);
+    return sum / LIGHT_AVERAGES;
 }
 
 /**
  * Gets the value of the right light sensor
  * after averaging the last few values.
  *
+ * @param robot The robot's state.
  * @return The value of the sensor.
  */
-float getRightLight() {
-    for(int i = numAverages-1; i > 0; i--) {
-        averageTwo[i] = averageTwo[i-1];
+float getRightLight(Robot &robot) {
+    profEnter(PROF_RIGHT_LIGHT);
+
+    for(int i = LIGHT_AVERAGES-1; i > 0; i--) {
+        robot.averageTwo[i] = robot.averageTwo[i-1];
     }
-    averageTwo[0] = SensorValue[rightLightSensor];
+    robot.averageTwo[0] = halGetSensor(rightLightSensor);
 
     float sum = 0;
-    for(int i = 0; i < numAverages; i++) {
-        sum += averageTwo[i];
+    for(int i = 0; i < LIGHT_AVERAGES; i++) {
+        sum += robot.averageTwo[i];
     }
 
-    return sum / numAverages;
+    profExit(PROF_RIGHT_LIGHT);
+    return sum / LIGHT_AVERAGES;
 }
 
 /**
- * Rotates the lighthouse assembly to a
- * specific angle relative to the back of the
- * robot using a PID loop.
+ * Starts rotating the lighthouse assembly to
+ * an angle. Call rotateToDegStep() every tick
+ * until it returns true; other maneuvers that
+ * don't use the lighthouse can run in the same
+ * loop.
  *
- * @param degrees The angle to rotate to.
- * @param maxSpeed The max allowed speed.
+ * @param robot The robot's state.
  * @param safeRange The range tollerance.
  * @param safeThreshold The time needed to be
  * in the safe zone before finishing.
  */
-void rotateToDeg(float degrees, int maxSpeed, int safeRange, int safeThreshold) {
-    PIDReset(lightPID);
+void rotateToDegStart(Robot &robot, int safeRange, int safeThreshold) {
+    PIDReset(robot.lightPID);
+    settleInit(robot.towerSettle, safeRange, safeThreshold, 0, TOWER_SETTLE_VEL, TOWER_STALL_VEL);
+}
 
-    int safeTime = 0;
-    int time     = 0;
-    int dTime    = 0;
+/**
+ * Runs one tick of rotating the lighthouse
+ * assembly to an angle.
+ *
+ * @param robot The robot's state.
+ * @param degrees The angle to rotate to.
+ * @param maxSpeed The max allowed speed.
+ * @return Whether the rotation has finished.
+ * The settle status says how.
+ */
+bool rotateToDegStep(Robot &robot, float degrees, int maxSpeed) {
+    profEnter(PROF_ROTATE_STEP);
 
-    while(true) {
+    float error = (degrees - towerAngle(robot)) * TICKS_PER_DEG;
+    float out = PIDCalculate(robot.lightPID, error);
 
-        dTime = nPgmTime - time;
-        time = nPgmTime;
+    out = clamp(out, maxSpeed);
+    setMotor(towerMotor, out);
 
-        float error = ((degrees * TICKS_PER_DEG)) - (SensorValue[towerPot] + POT_OFFSET);
-        float out = PIDCalculate(lightPID, error);
+    bool done = settleUpdate(robot.towerSettle, error, out);
+    if(done) {
+        setMotor(towerMotor, 0);
+    }
 
-        out = clamp(out, maxSpeed);
-        motor[towerMotor] = out;
+    profExit(PROF_ROTATE_STEP);
+    return done;
+}
 
-        safeTime = abs(error) < safeRange ? safeTime + dTime : 0;
+/**
+ * Rotates the lighthouse assembly to a
+ * specific angle relative to the back of the
+ * robot using a PID loop.
+ *
+ * @param robot The robot's state.
+ * @param degrees The angle to rotate to.
+ * @param maxSpeed The max allowed speed.
+ * @param safeRange The range tollerance.
+ * @param safeThreshold The time needed to be
+ * in the safe zone before finishing.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the lighthouse jammed.
+ */
+SettleStatus rotateToDeg(Robot &robot, float degrees, int maxSpeed, int safeRange, int safeThreshold) {
+    rotateToDegStart(robot, safeRange, safeThreshold);
 
-        if(safeTime > safeThreshold) {
-            break;
-        }
+    while(!rotateToDegStep(robot, degrees, maxSpeed)) {
+        execTick(robot.exec, robot.log);
     }
+    settleReport(robot.log, robot.towerSettle, LOG_SETTLE_ROTATE_TO);
 
-    motor[towerMotor] = 0;
+    return robot.towerSettle.status;
 }
 
 /**
  * Initialization code for the lighthouse
  * assembly PID controller.
+ *
+ * @param robot The robot's state.
  */
-void lightHouseInit() {
-    PIDInit(lightPID, LIGHTHOUSE_kP, LIGHTHOUSE_kI, LIGHTHOUSE_kD, 127, 0, LIGHTHOUSE_kS, true, LIGHTHOUSE_kR);
-    PIDReset(lightPID);
+void lightHouseInit(Robot &robot) {
+    PIDInit(robot.lightPID, LIGHTHOUSE_kP, LIGHTHOUSE_kI, LIGHTHOUSE_kD, 127, 0, LIGHTHOUSE_kS, true, LIGHTHOUSE_kR);
+    PIDReset(robot.lightPID);
 }
 
 /**
@@ -126,46 +164,193 @@ void lightHouseInit() {
  * aligned with the beacon; it's used mainly
  * for fine adjustment, not finding the beacon
  * from a dead start.
+ *
+ * @param robot The robot's state.
  */
-void autoTrackBeacon() {
-    float diff = getLeftLight() - (getRightLight() + L_SENSOR_DIFF);
+void autoTrackBeacon(Robot &robot) {
+    float diff = getLeftLight(robot) - (getRightLight(robot) + robot.lSensorDiff);
 
     if(abs(diff) > 0) {
-        motor[towerMotor] = sign(diff) * -17;
+        setMotor(towerMotor, sign(diff) * -17);
+    }
+    else {
+        setMotor(towerMotor, 0);
+    }
+}
+
+/**
+ * Remembers where the beacon is while it is
+ * being tracked confidently. The beacon is
+ * stored as a point in the odometry frame,
+ * from the lighthouse angle and the sonar
+ * range, so it can still be found after the
+ * robot has moved.
+ *
+ * The range only comes from a reading
+ * sonarValid() accepts. The sonar faces
+ * forward, so once the beacon is outside its
+ * cone it is ranging something else. In
+ * either case the last range is kept, and
+ * until there is one the brightness range
+ * stands in.
+ *
+ * @param robot The robot's state.
+ * @param light The beacon's brightness.
+ * @param sonar The raw sonar reading for this
+ * tick.
+ */
+void rememberBeacon(Robot &robot, float light, int sonar) {
+    float offAxis = towerAngle(robot) - 180;
+    float bearing = robot.poseTheta - offAxis * MATH_PI / 180;
+    bool sonarOk = sonarValid(sonar);
+    float range;
+    float lightRange;
+
+    if(robot.beaconKnown && (!sonarOk || abs(offAxis) > SONAR_CONE)) {
+        float dx = robot.beaconX - robot.poseX;
+        float dy = robot.beaconY - robot.poseY;
+        range = sqrt(dx * dx + dy * dy);
+    }
+    else if(sonarOk) {
+        range = sonar + SONAR_OFFSET;
+    }
+    else if(lightRangeEstimate(robot.lightRange, light, lightRange)) {
+        range = lightRange + SONAR_OFFSET;
     }
     else {
-        motor[towerMotor] = 0;
+        return;
+    }
+
+    robot.beaconX = robot.poseX + range * cos(bearing);
+    robot.beaconY = robot.poseY + range * sin(bearing);
+    robot.beaconKnown = true;
+}
+
+/**
+ * Gets the pot value that points the
+ * lighthouse at the remembered beacon from
+ * the robot's current pose.
+ *
+ * @param robot The robot's state.
+ * @return The pot value to aim for.
+ */
+float beaconPot(Robot &robot) {
+    float bearing = atan2(robot.beaconY - robot.poseY, robot.beaconX - robot.poseX) - robot.poseTheta;
+
+    // Wrap to +-180 degrees so the lighthouse takes
+    // the short way round.
+    while(bearing > MATH_PI) {
+        bearing -= 2 * MATH_PI;
+    }
+    while(bearing < -MATH_PI) {
+        bearing += 2 * MATH_PI;
+    }
+
+    return degreesToPot(180 - bearing * 180 / MATH_PI);
+}
+
+/**
+ * Runs one tick of the beacon-lost recovery.
+ * The lighthouse first slews straight to where
+ * the beacon was last seen. If it isn't there
+ * within RECOVER_SLEW_TIME, the lighthouse
+ * sweeps back and forth around that spot until
+ * RECOVER_SWEEP_TIME runs out, after which the
+ * recovery has failed.
+ *
+ * @param robot The robot's state.
+ */
+void recoverBeacon(Robot &robot) {
+    int elapsed = (timeMicros() - robot.recoverStart) / 1000;
+
+    // Steer the head rather than the pot, or the
+    // slew stops half the play short of the
+    // beacon.
+    float pot = degreesToPot(towerAngle(robot));
+
+    if(robot.recovery == RECOVER_SLEW) {
+        robot.recoverTarget = beaconPot(robot);
+        setMotor(towerMotor, clamp((robot.recoverTarget - pot) * RECOVER_SLEW_kP, MAX_SPEED));
+
+        if(elapsed > RECOVER_SLEW_TIME) {
+            robot.recovery = RECOVER_SWEEP;
+        }
+    }
+    else if(robot.recovery == RECOVER_SWEEP) {
+        float width = RECOVER_SWEEP_DEG * TICKS_PER_DEG;
+
+        if(pot > robot.recoverTarget + width) {
+            robot.lastDir = -1;
+        }
+        else if(pot < robot.recoverTarget - width) {
+            robot.lastDir = 1;
+        }
+
+        setMotor(towerMotor, RECOVER_SWEEP_SPEED * robot.lastDir);
+
+        if(elapsed > RECOVER_SLEW_TIME + RECOVER_SWEEP_TIME) {
+            setMotor(towerMotor, 0);
+            robot.recovery = RECOVER_FAILED;
+        }
     }
 }
 
 /**
  * it's like autoTrackBeacon.... but better...
+ *
+ * When both sensors lose the beacon the
+ * lighthouse goes looking for it with
+ * recoverBeacon(). If the beacon has never
+ * been seen confidently there is nowhere to
+ * slew to, so the recovery starts with the
+ * sweep around the current angle.
+ *
+ * @param robot The robot's state.
+ * @param sonar The raw sonar reading for this
+ * tick, from the caller's sensor snapshot.
  */
-void betterAutoTrack() {
-    float left = getLeftLight();
-    float right = getRightLight();
-    float diff = left - (right + L_SENSOR_DIFF);
+void betterAutoTrack(Robot &robot, int sonar) {
+    profEnter(PROF_AUTO_TRACK);
+
+    float left = getLeftLight(robot);
+    float right = getRightLight(robot);
+    float diff = left - (right + robot.lSensorDiff);
 
-    if(recovering) {
-        motor[towerMotor] = 15 * lastDir;
+    if(robot.recovery != RECOVER_NONE) {
         if(left > BEACON_FOUND_THRESH) {
-            recovering = false;
+            robot.recovery = RECOVER_NONE;
+        }
+        else {
+            recoverBeacon(robot);
         }
     }
     else {
         if(left < BEACON_LOST_THRESH && right < BEACON_LOST_THRESH) {
-            lastDir = sign(diff);
-            recovering = true;
+            robot.lastDir = sign(diff) == 0 ? 1 : sign(diff);
+            robot.recovery = robot.beaconKnown ? RECOVER_SLEW : RECOVER_SWEEP;
+            logInfo(robot, LOG_TRACK_LOST, robot.recovery, 0, 0);
+            robot.recoverStart = timeMicros();
+            robot.recoverTarget = degreesToPot(towerAngle(robot));
+
+            if(!robot.beaconKnown) {
+                robot.recoverStart -= RECOVER_SLEW_TIME * 1000;
+            }
         }
         else if(abs(diff) < 0) {
-            motor[towerMotor] = 0;
+            setMotor(towerMotor, 0);
         }
         else {
+            if(left > BEACON_FOUND_THRESH || right > BEACON_FOUND_THRESH) {
+                rememberBeacon(robot, left > right ? left : right, sonar);
+            }
+
             // Activation function to get the motor to track
             // the target object smoothly. Determined experimentally.
-            motor[towerMotor] = (diff * -TRACKING_SLOPE) - (TRACKING_MIN * sign(diff));
+            setMotor(towerMotor, (diff * -TRACKING_SLOPE) - (TRACKING_MIN * sign(diff)));
         }
     }
+
+    profExit(PROF_AUTO_TRACK);
 }
 
 /**
@@ -173,46 +358,52 @@ void betterAutoTrack() {
  * of just setting the motors for a certain amount
  * of time. Needed to ensure that the beacon is
  * exactly centered at the end of the scan.
+ *
+ * @param robot The robot's state.
+ * @return How the maneuver ended; SETTLE_STALLED
+ * if the lighthouse jammed.
  */
-void scanPID(float degrees, int maxSpeed, int safeRange, int safeThreshold) {
-    PIDReset(lightPID);
+SettleStatus scanPID(Robot &robot, float degrees, int maxSpeed, int safeRange, int safeThreshold) {
+    PIDReset(robot.lightPID);
 
-    int safeTime = 0;
-    int time     = 0;
-    int dTime    = 0;
-    int offset   = 0;
+    robot.highestValue = 0;
 
-    if(SensorValue[towerPot] < POT_TRACKING_THRESH) {
-        offset = POT_OFFSET_LEFT;
-    }
-    else {
-        offset = POT_OFFSET;
-    }
+    settleInit(robot.towerSettle, safeRange, safeThreshold, 0, TOWER_SETTLE_VEL, TOWER_STALL_VEL);
 
     while(true) {
+        profEnter(PROF_SCAN_PASS);
 
-        dTime = nPgmTime - time;
-        time = nPgmTime;
-
-        float error = ((degrees * TICKS_PER_DEG)) - (SensorValue[towerPot] + offset);
-        float out = PIDCalculate(lightPID, error);
+        float angle = towerAngle(robot);
+        float error = (degrees - angle) * TICKS_PER_DEG;
+        float out = PIDCalculate(robot.lightPID, error);
 
         out = clamp(out, maxSpeed);
-        motor[towerMotor] = out;
-
-        safeTime = abs(error) < safeRange ? safeTime + dTime : 0;
+        setMotor(towerMotor, out);
 
-        float val = getLeftLight();
-        if(val > highestValue) {
-            highestValue = val;
-            pos = SensorValue[towerPot];
+        float val = getLeftLight(robot);
+        if(val > robot.highestValue) {
+            robot.highestValue = val;
+            robot.pos = halGetSensor(towerPot);
+            robot.posInDegs = angle - SCAN_SENSOR_OFFSET;
         }
+        lightRangeDark(robot.lightRange, val);
 
-        if(safeTime > safeThreshold) {
+        mapUltraSonic(robot);
+
+        logDebugEvery(robot, 250, LOG_SCAN, error, val, robot.highestValue);
+
+        profExit(PROF_SCAN_PASS);
+        execTick(robot.exec, robot.log);
+
+        if(settleUpdate(robot.towerSettle, error, out)) {
             break;
         }
     }
 
-    posInDegs = (float)(pos+offset) / TICKS_PER_DEG;
-    motor[towerMotor] = 0;
+    setMotor(towerMotor, 0);
+    settleReport(robot.log, robot.towerSettle, LOG_SETTLE_SCAN);
+
+    return robot.towerSettle.status;
 }
+
+#endif
@@ -0,0 +1,259 @@
+/**
+ * This class estimates the range to the beacon
+ * from how bright it looks. The sonar only
+ * reaches GRID_SONAR_MAX and only sees the
+ * beacon inside its cone, but the photosensors
+ * see the beacon from anywhere in the arena.
+ *
+ * The light above ambient falls off roughly as
+ * 1 / (1 + (d / falloff)^2), so its inverse is
+ * a straight line in d^2:
+ *
+ *   1000 / (light - ambient) = a + b * x
+ *
+ * where x is (d / 1 m)^2 and d is the sonar
+ * range plus SONAR_OFFSET. The line is fitted
+ * by least squares to (light, sonar) pairs
+ * taken whenever the sonar has the beacon. It
+ * starts out from LIGHT_RANGE_A and
+ * LIGHT_RANGE_B, which are worth
+ * LIGHT_CAL_PRIOR pairs, so a few bad pairs
+ * can't throw it off. Once it holds
+ * LIGHT_CAL_MAX pairs the sums are halved, so
+ * the fit keeps up with the battery and the
+ * room.
+ *
+ * The ambient level starts out at
+ * LIGHT_AMBIENT and is then measured on every
+ * scan, as the darkest the beacon sensors saw
+ * while the lighthouse swept past the room.
+ * sim/NoiseTool.cpp fits the same line and
+ * ambient level offline from recorded traces,
+ * for the constants.
+ *
+ * @author Jayden Chan
+ * @date April 21, 2018
+ */
+
+#ifndef LIGHTRANGE_C
+#define LIGHTRANGE_C
+
+#include "Constants.h"
+#include "Utils.c"
+#include "HAL.h"
+
+typedef struct {
+    // Weighted sums for the fit.
+    float n, sx, sy, sxx, sxy;
+
+    // The current line.
+    float a, b;
+    int pairs;
+
+    // The filtered range, and whether the last
+    // reading had one.
+    float range;
+    bool ranging;
+
+    // The ambient level, and the darkest
+    // reading of the scan under way and how
+    // many readings it has had.
+    float ambient;
+    float dark;
+    int scanned;
+} LightRange;
+
+/**
+ * Adds a point to the fit's sums.
+ *
+ * @param lr The estimator.
+ * @param x The squared range in m^2.
+ * @param y The inverse light.
+ * @param weight How many pairs it counts as.
+ */
+void lightRangeSum(LightRange &lr, float x, float y, float weight) {
+    lr.n += weight;
+    lr.sx += weight * x;
+    lr.sy += weight * y;
+    lr.sxx += weight * x * x;
+    lr.sxy += weight * x * y;
+}
+
+/**
+ * Resets the estimator to the default line.
+ * The defaults go in as two points, at 0.5 m
+ * and 1.5 m, so the fit always has a spread
+ * to work from.
+ *
+ * @param lr The estimator to reset.
+ */
+void lightRangeInit(LightRange &lr) {
+    lr.n = 0;
+    lr.sx = 0;
+    lr.sy = 0;
+    lr.sxx = 0;
+    lr.sxy = 0;
+
+    lightRangeSum(lr, 0.25, LIGHT_RANGE_A + LIGHT_RANGE_B * 0.25, LIGHT_CAL_PRIOR / 2);
+    lightRangeSum(lr, 2.25, LIGHT_RANGE_A + LIGHT_RANGE_B * 2.25, LIGHT_CAL_PRIOR / 2);
+
+    lr.a = LIGHT_RANGE_A;
+    lr.b = LIGHT_RANGE_B;
+    lr.pairs = 0;
+    lr.range = 0;
+    lr.ranging = false;
+    lr.ambient = LIGHT_AMBIENT;
+    lr.dark = 4095;
+    lr.scanned = 0;
+}
+
+/**
+ * Notes a beacon sensor reading taken during a
+ * scan, for the ambient level. The first
+ * LIGHT_AVERAGES readings still average in
+ * whatever the filter held before the scan,
+ * which is zeros on the first one, so they
+ * are skipped.
+ *
+ * @param lr The estimator.
+ * @param light The averaged reading.
+ */
+void lightRangeDark(LightRange &lr, float light) {
+    lr.scanned++;
+    if(lr.scanned > LIGHT_AVERAGES && light < lr.dark) {
+        lr.dark = light;
+    }
+}
+
+/**
+ * Takes the darkest reading of the scan that
+ * just ended as the ambient level. A scan that
+ * never got darker than BEACON_LOST_THRESH
+ * didn't look away from the beacon, and says
+ * nothing about the room, so it is ignored.
+ *
+ * @param lr The estimator.
+ */
+void lightRangeScanned(LightRange &lr) {
+    if(lr.dark < BEACON_LOST_THRESH) {
+        lr.ambient = lr.dark;
+    }
+    lr.dark = 4095;
+    lr.scanned = 0;
+}
+
+/**
+ * Adds a (light, sonar) pair to the fit. Call
+ * it only while the sonar is ranging the
+ * beacon and the lighthouse is on it.
+ *
+ * @param lr The estimator.
+ * @param light The beacon's brightness.
+ * @param sonar The sonar range in cm.
+ */
+void lightRangeAdd(LightRange &lr, float light, float sonar) {
+    if(light - lr.ambient < LIGHT_RANGE_MIN) {
+        return;
+    }
+
+    float d = (sonar + SONAR_OFFSET) / 100;
+    float x = d * d;
+    float y = 1000 / (light - lr.ambient);
+
+    // Drop pairs the line can't have come from,
+    // like the sonar catching something else.
+    float expected = lr.a + lr.b * x;
+    if(abs(y - expected) > LIGHT_CAL_REJECT * expected) {
+        return;
+    }
+
+    lightRangeSum(lr, x, y, 1);
+    lr.pairs++;
+
+    if(lr.n > LIGHT_CAL_MAX) {
+        lr.n /= 2;
+        lr.sx /= 2;
+        lr.sy /= 2;
+        lr.sxx /= 2;
+        lr.sxy /= 2;
+    }
+
+    // The prior keeps the spread above 0, but
+    // a line that doesn't fall off with range
+    // is no use.
+    float det = lr.n * lr.sxx - lr.sx * lr.sx;
+    float b = (lr.n * lr.sxy - lr.sx * lr.sy) / det;
+    float a = (lr.sy - b * lr.sx) / lr.n;
+
+    if(a > 0 && b > 0) {
+        lr.a = a;
+        lr.b = b;
+    }
+}
+
+/**
+ * Gets the range a single brightness reading
+ * suggests, measured like the sonar measures
+ * it, without filtering it.
+ *
+ * @param lr The estimator.
+ * @param light The beacon's brightness.
+ * @param range The range in cm, if there is
+ * one.
+ * @return Whether the beacon is bright enough
+ * to range.
+ */
+bool lightRangeEstimate(LightRange &lr, float light, float &range) {
+    if(light - lr.ambient < LIGHT_RANGE_MIN) {
+        return false;
+    }
+
+    float x = (1000 / (light - lr.ambient) - lr.a) / lr.b;
+    float d = x > 0 ? 100 * sqrt(x) : 0;
+    range = clamp2(d - SONAR_OFFSET, 0, LIGHT_RANGE_MAX);
+    return true;
+}
+
+/**
+ * Gets the range the beacon's brightness
+ * suggests, measured like the sonar measures
+ * it. The lighthouse wobbles about the beacon
+ * as it tracks, which makes the brightness
+ * jitter, so the range is low-pass filtered;
+ * it would otherwise go straight into the
+ * range controller's D term.
+ *
+ * @param lr The estimator.
+ * @param light The beacon's brightness.
+ * @param range The range in cm, if there is
+ * one.
+ * @return Whether the beacon is bright enough
+ * to range.
+ */
+bool lightRangeGet(LightRange &lr, float light, float &range) {
+    float d;
+    if(!lightRangeEstimate(lr, light, d)) {
+        lr.ranging = false;
+        return false;
+    }
+
+    lr.range = lr.ranging ? lr.range + LIGHT_RANGE_FILTER * (d - lr.range) : d;
+    lr.ranging = true;
+
+    range = lr.range;
+    return true;
+}
+
+/**
+ * Writes the fitted line and the ambient
+ * level to the debug stream, to compare with
+ * LIGHT_RANGE_A, LIGHT_RANGE_B and
+ * LIGHT_AMBIENT.
+ *
+ * @param lr The estimator.
+ */
+void lightRangeReport(LightRange &lr) {
+    writeDebugStreamLine("light range: a %.3f, b %.4f from %d pairs, ambient %.0f", lr.a, lr.b, lr.pairs, lr.ambient);
+}
+
+#endif
@@ -0,0 +1,291 @@
+/**
+ * This class contains the robot's logging.
+ * Writing to the debug stream is slow enough
+ * to upset the control loops, so log calls
+ * only record a message id and up to three
+ * values into a small buffer. The text is
+ * built later: execTick() writes one entry
+ * whenever a tick has time to spare, and
+ * logFlush() writes whatever is left between
+ * maneuvers. Entries that don't fit in the
+ * buffer are counted and the count is
+ * reported.
+ *
+ * Every message has an id in LogMessage and
+ * its format in logWrite(), so every format is
+ * a literal with arguments of the right type.
+ * Unused values should be 0:
+ *
+ *   logWarn(robot, LOG_ROTATE_STALLED, 0, 0, 0);
+ *   logDebugEvery(robot, 250, LOG_RANGE, sonar, range, light);
+ *
+ * Every level has its own macro, and any level
+ * above LOG_LEVEL compiles to nothing, so its
+ * arguments aren't even evaluated. The *Every
+ * variants are rate limited per message and
+ * are meant for the inside of control loops.
+ *
+ * @author Jayden Chan
+ * @date April 15, 2018
+ */
+
+#ifndef LOG_C
+#define LOG_C
+
+#include "Constants.h"
+#include "Timebase.c"
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Override on the command line (or before
+// including this file) to log more or less.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_WARN
+#endif
+
+typedef enum {
+    LOG_CALLIBRATE_GAVE_UP,
+    LOG_SCAN_STALLED,
+    LOG_SCAN,
+    LOG_ROTATE_STALLED,
+    LOG_MISSION_TARGET,
+    LOG_TURN_PLAN,
+    LOG_TURN_DONE,
+    LOG_TRACK_LOST,
+    LOG_APPROACH,
+    LOG_APPROACH_PLAN_SLOW,
+    LOG_APPROACH_LOST,
+    LOG_RANGE,
+    LOG_BACK,
+    LOG_SETTLE_CALLIBRATE,
+    LOG_SETTLE_ROTATE,
+    LOG_SETTLE_SCAN,
+    LOG_SETTLE_ROTATE_TO,
+    LOG_MESSAGES
+} LogMessage;
+
+typedef struct {
+    short level;
+    short message;
+    long time;
+    float a, b, c;
+} LogEntry;
+
+typedef struct {
+    LogEntry entries[LOG_CAPACITY];
+    int head, count;
+    int dropped, suppressed;
+
+    // When each message was last recorded, for
+    // the rate limited calls.
+    long messageTime[LOG_MESSAGES];
+} Log;
+
+/**
+ * Empties the log.
+ *
+ * @param log The log to clear.
+ */
+void logInit(Log &log) {
+    log.head = 0;
+    log.count = 0;
+    log.dropped = 0;
+    log.suppressed = 0;
+
+    // Long enough ago for any rate limit.
+    for(int i = 0; i < LOG_MESSAGES; i++) {
+        log.messageTime[i] = timeMillis() - LOG_RATE_MAX;
+    }
+}
+
+/**
+ * Records a log entry without formatting it.
+ * Use the level macros instead of calling this
+ * directly, so disabled levels compile out.
+ *
+ * @param log The log to record into.
+ * @param level The entry's level.
+ * @param interval The minimum time between
+ * entries of this message, or 0 for none.
+ * @param message The message's id.
+ * @param a The first value.
+ * @param b The second value.
+ * @param c The third value.
+ */
+void logRecord(Log &log, int level, int interval, LogMessage message, float a, float b, float c) {
+    long now = timeMillis();
+
+    if(interval > 0) {
+        if((long)(now - log.messageTime[message]) < interval) {
+            log.suppressed++;
+            return;
+        }
+        log.messageTime[message] = now;
+    }
+
+    if(log.count == LOG_CAPACITY) {
+        log.dropped++;
+        return;
+    }
+
+    int slot = (log.head + log.count) % LOG_CAPACITY;
+    log.entries[slot].level = level;
+    log.entries[slot].message = message;
+    log.entries[slot].time = now;
+    log.entries[slot].a = a;
+    log.entries[slot].b = b;
+    log.entries[slot].c = c;
+    log.count++;
+}
+
+/**
+ * Formats one entry and writes it to the
+ * debug stream.
+ *
+ * @param e The entry to write.
+ */
+void logWrite(LogEntry &e) {
+    if(e.level == LOG_LEVEL_ERROR) {
+        writeDebugStream("E %d ", (int)e.time);
+    }
+    else if(e.level == LOG_LEVEL_WARN) {
+        writeDebugStream("W %d ", (int)e.time);
+    }
+    else if(e.level == LOG_LEVEL_INFO) {
+        writeDebugStream("I %d ", (int)e.time);
+    }
+    else {
+        writeDebugStream("D %d ", (int)e.time);
+    }
+
+    switch(e.message) {
+    case LOG_CALLIBRATE_GAVE_UP:
+        writeDebugStreamLine("callibrate: gave up, status %d", (int)e.a);
+        break;
+    case LOG_SCAN_STALLED:
+        writeDebugStreamLine("scan: lighthouse stalled at pot %d", (int)e.a);
+        break;
+    case LOG_SCAN:
+        writeDebugStreamLine("scan: error %d, light %d, best %d", (int)e.a, (int)e.b, (int)e.c);
+        break;
+    case LOG_ROTATE_STALLED:
+        writeDebugStreamLine("rotate: drivetrain stalled");
+        break;
+    case LOG_MISSION_TARGET:
+        writeDebugStreamLine("mission: target %d of %d", (int)e.a, (int)e.b);
+        break;
+    case LOG_TURN_PLAN:
+        writeDebugStreamLine("turn: %d deg, predicted %d ms", (int)e.a, (int)e.b);
+        break;
+    case LOG_TURN_DONE:
+        writeDebugStreamLine("turn: took %d ms, accel %.4f, decel %.4f", (int)e.a, e.b, e.c);
+        break;
+    case LOG_TRACK_LOST:
+        writeDebugStreamLine("track: beacon lost, recovery %d", (int)e.a);
+        break;
+    case LOG_APPROACH:
+        writeDebugStreamLine("approach: range %d, ratio %.2f, right %d", (int)e.a, e.b, (int)e.c);
+        break;
+    case LOG_APPROACH_PLAN_SLOW:
+        writeDebugStreamLine("approach: plan took %d us", (int)e.a);
+        break;
+    case LOG_APPROACH_LOST:
+        writeDebugStreamLine("approach: beacon lost");
+        break;
+    case LOG_RANGE:
+        writeDebugStreamLine("range: sonar %d, light %d, brightness %d", (int)e.a, (int)e.b, (int)e.c);
+        break;
+    case LOG_BACK:
+        writeDebugStreamLine("back: %.1f cm in %d ms", e.a, (int)e.b);
+        break;
+    case LOG_SETTLE_CALLIBRATE:
+        writeDebugStreamLine("callibrate: status %d, %d ms, %d iterations", (int)e.a, (int)e.b, (int)e.c);
+        break;
+    case LOG_SETTLE_ROTATE:
+        writeDebugStreamLine("rotate: status %d, %d ms, %d iterations", (int)e.a, (int)e.b, (int)e.c);
+        break;
+    case LOG_SETTLE_SCAN:
+        writeDebugStreamLine("scan: status %d, %d ms, %d iterations", (int)e.a, (int)e.b, (int)e.c);
+        break;
+    case LOG_SETTLE_ROTATE_TO:
+        writeDebugStreamLine("rotateToDeg: status %d, %d ms, %d iterations", (int)e.a, (int)e.b, (int)e.c);
+        break;
+    default:
+        writeDebugStreamLine("log: unknown message %d", e.message);
+    }
+}
+
+/**
+ * Writes the oldest pending entry, if there is
+ * one. execTick() calls this when a tick has
+ * time to spare.
+ *
+ * @param log The log to write from.
+ */
+void logFlushOne(Log &log) {
+    if(log.count == 0) {
+        return;
+    }
+
+    logWrite(log.entries[log.head]);
+    log.head = (log.head + 1) % LOG_CAPACITY;
+    log.count--;
+}
+
+/**
+ * Writes every pending entry, then how many
+ * were dropped or rate limited since the last
+ * flush. Call this where the robot can afford
+ * to wait, never inside a loop.
+ *
+ * @param log The log to flush.
+ */
+void logFlush(Log &log) {
+    while(log.count > 0) {
+        logFlushOne(log);
+    }
+
+    if(log.dropped > 0 || log.suppressed > 0) {
+        writeDebugStreamLine("log: %d dropped, %d rate limited", log.dropped, log.suppressed);
+        log.dropped = 0;
+        log.suppressed = 0;
+    }
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define logError(robot, message, a, b, c)              logRecord((robot).log, LOG_LEVEL_ERROR, 0, message, a, b, c)
+#define logErrorEvery(robot, ms, message, a, b, c)     logRecord((robot).log, LOG_LEVEL_ERROR, ms, message, a, b, c)
+#else
+#define logError(robot, message, a, b, c)
+#define logErrorEvery(robot, ms, message, a, b, c)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define logWarn(robot, message, a, b, c)               logRecord((robot).log, LOG_LEVEL_WARN, 0, message, a, b, c)
+#define logWarnEvery(robot, ms, message, a, b, c)      logRecord((robot).log, LOG_LEVEL_WARN, ms, message, a, b, c)
+#else
+#define logWarn(robot, message, a, b, c)
+#define logWarnEvery(robot, ms, message, a, b, c)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define logInfo(robot, message, a, b, c)               logRecord((robot).log, LOG_LEVEL_INFO, 0, message, a, b, c)
+#define logInfoEvery(robot, ms, message, a, b, c)      logRecord((robot).log, LOG_LEVEL_INFO, ms, message, a, b, c)
+#else
+#define logInfo(robot, message, a, b, c)
+#define logInfoEvery(robot, ms, message, a, b, c)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define logDebug(robot, message, a, b, c)              logRecord((robot).log, LOG_LEVEL_DEBUG, 0, message, a, b, c)
+#define logDebugEvery(robot, ms, message, a, b, c)     logRecord((robot).log, LOG_LEVEL_DEBUG, ms, message, a, b, c)
+#else
+#define logDebug(robot, message, a, b, c)
+#define logDebugEvery(robot, ms, message, a, b, c)
+#endif
+
+#endif
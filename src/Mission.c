@@ -0,0 +1,140 @@
+/**
+ * This class contains the mission layer, which
+ * lets the robot connect to several targets in
+ * a row without being restarted. The mission is
+ * a queue of targets, each with its own
+ * maneuver parameters. When the robot departs
+ * from one target it goes straight back to
+ * scanning from wherever it is, and the time
+ * spent on each phase of every target is
+ * recorded for missionReport().
+ *
+ * The number of targets defaults to one, which
+ * is a normal competition run. Override
+ * MISSION_TARGETS on the command line (or
+ * before including this file) for back-to-back
+ * connection trials.
+ *
+ * @author Jayden Chan
+ * @date April 16, 2018
+ */
+
+#ifndef MISSION_C
+#define MISSION_C
+
+#include "Constants.h"
+#include "Timebase.c"
+
+#ifndef MISSION_TARGETS
+#define MISSION_TARGETS 1
+#endif
+
+typedef struct {
+    int count;
+    int current;
+
+    // Per-target parameters.
+    int approachSpeed[MISSION_MAX];
+    int scanTurnSpeed[MISSION_MAX];
+
+    // Per-target timings, in ms since the program
+    // started.
+    long startTime[MISSION_MAX];
+    long approachTime[MISSION_MAX];
+    long connectTime[MISSION_MAX];
+    long endTime[MISSION_MAX];
+} Mission;
+
+/**
+ * Loads the mission's targets from the
+ * MISSION_* tables in the constants file.
+ *
+ * @param mission The mission to load.
+ * @param count The number of targets, up to
+ * MISSION_MAX.
+ */
+void missionInit(Mission &mission, int count) {
+    mission.count = count < MISSION_MAX ? count : MISSION_MAX;
+    mission.current = 0;
+
+    for(int i = 0; i < MISSION_MAX; i++) {
+        mission.approachSpeed[i] = MISSION_APPROACH_SPEED[i];
+        mission.scanTurnSpeed[i] = MISSION_SCAN_TURN_SPEED[i];
+        mission.startTime[i] = 0;
+        mission.approachTime[i] = 0;
+        mission.connectTime[i] = 0;
+        mission.endTime[i] = 0;
+    }
+}
+
+/**
+ * Marks the start of the current target, when
+ * the robot starts scanning for it.
+ *
+ * @param mission The mission to update.
+ */
+void missionBegin(Mission &mission) {
+    mission.startTime[mission.current] = timeMillis();
+}
+
+/**
+ * Marks the start of the approach to the
+ * current target.
+ *
+ * @param mission The mission to update.
+ */
+void missionApproach(Mission &mission) {
+    mission.approachTime[mission.current] = timeMillis();
+}
+
+/**
+ * Marks the cable as connected to the current
+ * target.
+ *
+ * @param mission The mission to update.
+ */
+void missionConnected(Mission &mission) {
+    mission.connectTime[mission.current] = timeMillis();
+}
+
+/**
+ * Finishes the current target and moves on to
+ * the next one.
+ *
+ * @param mission The mission to update.
+ * @return Whether there is another target.
+ */
+bool missionNext(Mission &mission) {
+    mission.endTime[mission.current] = timeMillis();
+
+    if(mission.current + 1 >= mission.count) {
+        return false;
+    }
+
+    mission.current++;
+    missionBegin(mission);
+    return true;
+}
+
+/**
+ * Writes the timings of every target reached so
+ * far to the debug stream: time spent scanning
+ * and rotating, approaching, and in total.
+ *
+ * @param mission The mission to report.
+ */
+void missionReport(Mission &mission) {
+    for(int i = 0; i <= mission.current && i < mission.count; i++) {
+        if(mission.connectTime[i] == 0) {
+            writeDebugStreamLine("target %d: not connected", i + 1);
+            continue;
+        }
+
+        writeDebugStreamLine("target %d: scan %d ms, approach %d ms, total %d ms", i + 1,
+            (int)(mission.approachTime[i] - mission.startTime[i]),
+            (int)(mission.connectTime[i] - mission.approachTime[i]),
+            (int)(mission.endTime[i] - mission.startTime[i]));
+    }
+}
+
+#endif
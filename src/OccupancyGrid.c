@@ -0,0 +1,258 @@
+/**
+ * This class contains a sparse occupancy grid
+ * of the arena, built from ultrasonic readings
+ * tagged with the robot's pose. Only cells
+ * that have returned an echo are stored, so
+ * the whole 2.3m arena fits in a little over
+ * a hundred bytes. Cells the sound passed
+ * through on its way to an echo are cleared
+ * again, so moving targets don't leave ghosts
+ * behind.
+ *
+ * Coordinates are in cm in the odometry frame
+ * (see Odometry.c), angles in radians.
+ *
+ * Each cell is packed into one short: 6 bits
+ * each for its x and y index, offset by
+ * GRID_HALF_SPAN, and 3 bits for its hit
+ * count. That covers GRID_HALF_SPAN cells
+ * either side of where the robot started,
+ * which is more than the arena, and echoes
+ * outside it are dropped.
+ *
+ * @author Jayden Chan
+ * @date April 11, 2018
+ */
+
+#ifndef OCCUPANCYGRID_C
+#define OCCUPANCYGRID_C
+
+#include "Constants.h"
+#include "Utils.c"
+
+typedef struct {
+    int size;
+    short cells[GRID_CAPACITY];
+} OccupancyGrid;
+
+/**
+ * Gets a cell's x index.
+ *
+ * @param grid The grid.
+ * @param index The index of the cell.
+ * @return The cell's x index.
+ */
+int gridCellX(OccupancyGrid &grid, int index) {
+    return (grid.cells[index] & 63) - GRID_HALF_SPAN;
+}
+
+/**
+ * Gets a cell's y index.
+ *
+ * @param grid The grid.
+ * @param index The index of the cell.
+ * @return The cell's y index.
+ */
+int gridCellY(OccupancyGrid &grid, int index) {
+    return ((grid.cells[index] >> 6) & 63) - GRID_HALF_SPAN;
+}
+
+/**
+ * Gets how many echoes a cell has returned.
+ *
+ * @param grid The grid.
+ * @param index The index of the cell.
+ * @return The cell's hit count.
+ */
+int gridHits(OccupancyGrid &grid, int index) {
+    return (grid.cells[index] >> 12) & 7;
+}
+
+/**
+ * Packs a cell into a slot.
+ *
+ * @param grid The grid.
+ * @param index The slot to write.
+ * @param cx The cell's x index.
+ * @param cy The cell's y index.
+ * @param hits The cell's hit count.
+ */
+void gridSetCell(OccupancyGrid &grid, int index, int cx, int cy, int hits) {
+    grid.cells[index] = (cx + GRID_HALF_SPAN) | ((cy + GRID_HALF_SPAN) << 6) | (hits << 12);
+}
+
+/**
+ * Empties the grid.
+ *
+ * @param grid The grid to clear.
+ */
+void gridInit(OccupancyGrid &grid) {
+    grid.size = 0;
+}
+
+/**
+ * Removes a cell from the grid by moving the
+ * last cell into its slot.
+ *
+ * @param grid The grid to remove from.
+ * @param index The index of the cell.
+ */
+void gridRemove(OccupancyGrid &grid, int index) {
+    grid.size--;
+    grid.cells[index] = grid.cells[grid.size];
+}
+
+/**
+ * Records an echo in a cell. When the grid is
+ * full the weakest cell is replaced, but only
+ * if it has been seen just once.
+ *
+ * @param grid The grid to mark.
+ * @param cx The cell's x index.
+ * @param cy The cell's y index.
+ */
+void gridMark(OccupancyGrid &grid, int cx, int cy) {
+    if(abs(cx) >= GRID_HALF_SPAN || abs(cy) >= GRID_HALF_SPAN) {
+        return;
+    }
+
+    int weakest = 0;
+
+    for(int i = 0; i < grid.size; i++) {
+        int hits = gridHits(grid, i);
+
+        if(gridCellX(grid, i) == cx && gridCellY(grid, i) == cy) {
+            if(hits < GRID_MAX_HITS) {
+                gridSetCell(grid, i, cx, cy, hits + 1);
+            }
+            return;
+        }
+        if(hits < gridHits(grid, weakest)) {
+            weakest = i;
+        }
+    }
+
+    int slot = grid.size;
+    if(grid.size < GRID_CAPACITY) {
+        grid.size++;
+    }
+    else if(gridHits(grid, weakest) <= 1) {
+        slot = weakest;
+    }
+    else {
+        return;
+    }
+
+    gridSetCell(grid, slot, cx, cy, 1);
+}
+
+/**
+ * Adds an ultrasonic reading to the grid. Only
+ * pass readings sonarValid() accepts.
+ *
+ * @param grid The grid to update.
+ * @param x The robot's x position.
+ * @param y The robot's y position.
+ * @param theta The robot's heading.
+ * @param range The raw ultrasonic reading in cm.
+ */
+void gridAddReading(OccupancyGrid &grid, float x, float y, float theta, float range) {
+    float c = cos(theta);
+    float s = sin(theta);
+    float ox = x + SONAR_OFFSET * c;
+    float oy = y + SONAR_OFFSET * s;
+
+    // Clear any cells the sound passed through.
+    for(int i = grid.size - 1; i >= 0; i--) {
+        int cx = gridCellX(grid, i);
+        int cy = gridCellY(grid, i);
+        float px = (cx + 0.5) * GRID_CELL - ox;
+        float py = (cy + 0.5) * GRID_CELL - oy;
+        float along = px * c + py * s;
+        float across = py * c - px * s;
+
+        if(along > 0 && along < range - GRID_CELL && abs(across) < GRID_CELL * 0.7) {
+            int hits = gridHits(grid, i) - 1;
+            if(hits <= 0) {
+                gridRemove(grid, i);
+            }
+            else {
+                gridSetCell(grid, i, cx, cy, hits);
+            }
+        }
+    }
+
+    gridMark(grid, floor((ox + range * c) / GRID_CELL), floor((oy + range * s) / GRID_CELL));
+}
+
+/**
+ * Checks whether the robot can drive along an
+ * arc without passing within the clearance of
+ * an occupied cell.
+ *
+ * @param grid The grid to check against.
+ * @param x The robot's x position.
+ * @param y The robot's y position.
+ * @param theta The robot's heading.
+ * @param curvature The arc's curvature in 1/cm,
+ * positive to the left.
+ * @param length The length of the arc to check.
+ * @param clearance The required clearance.
+ * @return Whether the arc is clear.
+ */
+bool gridArcClear(OccupancyGrid &grid, float x, float y, float theta, float curvature, float length, float clearance) {
+    float c = cos(theta);
+    float s = sin(theta);
+
+    for(int i = 0; i < grid.size; i++) {
+        if(gridHits(grid, i) < GRID_OCCUPIED) {
+            continue;
+        }
+
+        // Cell centre in the robot's frame.
+        float dx = (gridCellX(grid, i) + 0.5) * GRID_CELL - x;
+        float dy = (gridCellY(grid, i) + 0.5) * GRID_CELL - y;
+        float fwd = dx * c + dy * s;
+        float left = dy * c - dx * s;
+
+        if(fwd < 0 || fwd > length + clearance) {
+            continue;
+        }
+
+        float dist, along;
+
+        if(abs(curvature) < 0.0001) {
+            dist = abs(left);
+            along = fwd;
+        }
+        else {
+            float radius = 1 / curvature;
+            dist = abs(sqrt(fwd * fwd + (left - radius) * (left - radius)) - abs(radius));
+            along = abs(radius) * atan2(fwd, abs(radius) - sign(radius) * left);
+        }
+
+        if(dist < clearance && along < length) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Counts the occupied cells in the grid.
+ *
+ * @param grid The grid to count.
+ * @return The number of occupied cells.
+ */
+int gridOccupied(OccupancyGrid &grid) {
+    int count = 0;
+    for(int i = 0; i < grid.size; i++) {
+        if(gridHits(grid, i) >= GRID_OCCUPIED) {
+            count++;
+        }
+    }
+    return count;
+}
+
+#endif
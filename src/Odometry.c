@@ -0,0 +1,143 @@
+/**
+ * This class keeps track of the robot's pose
+ * (position and heading) from the drive
+ * encoders. The pose is relative to where the
+ * robot was when it started: x points forward,
+ * y to the left, and the heading is CCW in
+ * radians.
+ *
+ * The maneuvers reset the encoders all the
+ * time, so they must do it through
+ * resetDriveEncoders() so that no distance is
+ * lost from the pose.
+ *
+ * An encoder read can glitch, most often to 0.
+ * A wheel can't have moved further than
+ * ODOMETRY_GLITCH times its top speed allows
+ * since the last update, so a reading that
+ * says it has is dropped, and the next good
+ * one picks up the movement.
+ *
+ * @author Jayden Chan
+ * @date April 11, 2018
+ */
+
+#ifndef ODOMETRY_C
+#define ODOMETRY_C
+
+#include "Constants.h"
+#include "Robot.c"
+#include "Timebase.c"
+#include "Ultrasonic.c"
+#include "Profiler.c"
+#include "HAL.h"
+
+/**
+ * Puts the robot back at the origin of the
+ * odometry frame.
+ *
+ * @param robot The robot's state.
+ */
+void odometryReset(Robot &robot) {
+    robot.poseX = 0;
+    robot.poseY = 0;
+    robot.poseTheta = 0;
+    robot.lastLeftTicks = halGetEncoder(leftMotor);
+    robot.lastRightTicks = halGetEncoder(rightMotor);
+    robot.odometryTime = timeMicros();
+
+    robot.leftSpeed = 0;
+    robot.rightSpeed = 0;
+    robot.speedLeftTicks = robot.lastLeftTicks;
+    robot.speedRightTicks = robot.lastRightTicks;
+    robot.speedTime = timeMicros();
+}
+
+/**
+ * Integrates the encoder movement since the
+ * last update into the robot's pose. If
+ * either wheel moved further than it could
+ * have, the update is skipped.
+ *
+ * @param robot The robot's state.
+ */
+void odometryUpdate(Robot &robot) {
+    profEnter(PROF_ODOMETRY);
+
+    long left = halGetEncoder(leftMotor);
+    long right = halGetEncoder(rightMotor);
+    long now = timeMicros();
+
+    float dLeft = (left - robot.lastLeftTicks) / TICKS_PER_CM2;
+    float dRight = (right - robot.lastRightTicks) / TICKS_PER_CM2;
+
+    float limit = DRIVE_TOP_SPEED * ODOMETRY_GLITCH * (now - robot.odometryTime) / 1000000.0 + ODOMETRY_SLACK;
+
+    if(abs(dLeft) > limit || abs(dRight) > limit) {
+        profExit(PROF_ODOMETRY);
+        return;
+    }
+
+    robot.lastLeftTicks = left;
+    robot.lastRightTicks = right;
+    robot.odometryTime = now;
+
+    float dTheta = (dRight - dLeft) / DRIVETRAIN_WIDTH;
+    float heading = robot.poseTheta + dTheta / 2;
+    float distance = (dLeft + dRight) / 2;
+
+    robot.poseX += distance * cos(heading);
+    robot.poseY += distance * sin(heading);
+    robot.poseTheta += dTheta;
+
+    // Wheel speeds are measured over a longer
+    // window than a single update, otherwise the
+    // encoder resolution swamps them.
+    float dt = (now - robot.speedTime) / 1000000.0;
+
+    if(dt >= ODOMETRY_SPEED_DT) {
+        robot.leftSpeed = (left - robot.speedLeftTicks) / TICKS_PER_CM2 / dt;
+        robot.rightSpeed = (right - robot.speedRightTicks) / TICKS_PER_CM2 / dt;
+        robot.speedLeftTicks = left;
+        robot.speedRightTicks = right;
+        robot.speedTime = now;
+    }
+
+    profExit(PROF_ODOMETRY);
+}
+
+/**
+ * Resets both drive encoders without losing
+ * any movement from the pose.
+ *
+ * @param robot The robot's state.
+ */
+void resetDriveEncoders(Robot &robot) {
+    odometryUpdate(robot);
+
+    halResetEncoder(rightMotor);
+    halResetEncoder(leftMotor);
+
+    robot.speedLeftTicks -= robot.lastLeftTicks;
+    robot.speedRightTicks -= robot.lastRightTicks;
+    robot.lastLeftTicks = 0;
+    robot.lastRightTicks = 0;
+}
+
+/**
+ * Updates the pose and adds the current
+ * ultrasonic reading to the occupancy grid,
+ * if it is a real range.
+ *
+ * @param robot The robot's state.
+ */
+void mapUltraSonic(Robot &robot) {
+    odometryUpdate(robot);
+
+    int sonar = halGetSensor(ultrasonic);
+    if(sonarValid(sonar)) {
+        gridAddReading(robot.grid, robot.poseX, robot.poseY, robot.poseTheta, sonar);
+    }
+}
+
+#endif
@@ -9,37 +9,64 @@
  * @date February 16, 2018
  */
 
+#ifndef OKARITO_C
+#define OKARITO_C
+
 #include "DriveBase.c"
 #include "RobotStates.h"
 #include "LEDController.c"
 #include "LightHouse.c"
 #include "CableGuide.c"
-
-RobotState currentState = STATE_ENABLED;
+#include "Battery.c"
+#include "HAL.h"
 
 /**
  * Function used for testing only.
+ *
+ * @param robot The robot's state.
  */
-void testPeriodic() {
+void testPeriodic(Robot &robot) {
     toggleRainbowLED();
     toggleRedLED();
-    currentState = STATE_DISABLED;
+    robot.currentState = STATE_DISABLED;
 }
 
 /**
  * Callibrates the robot's lighthouse assembly
  * so that it reads the correct values every time.
+ * Gives up after CALIBRATE_TIMEOUT, or sooner if
+ * the pot stops moving, so a jammed lighthouse
+ * can't hold the motor against an end stop.
+ *
+ * @param robot The robot's state.
  */
-void callibrate() {
-    if(SensorValue[button2]) {
-        motor[towerMotor] = 20;
+void callibrate(Robot &robot) {
+    if(!robot.calibrating) {
+        settleInit(robot.towerSettle, 0, 0, CALIBRATE_TIMEOUT, 0, TOWER_STALL_VEL);
+        robot.calibrating = true;
     }
-    else if(SensorValue[limitSwitch]) {
-        motor[towerMotor] = -20;
+
+    int power = 0;
+
+    if(halGetSensor(button2)) {
+        power = 20;
     }
-    else {
-        motor[towerMotor] = 0;
-        currentState = STATE_WAITING;
+    else if(halGetSensor(limitSwitch)) {
+        power = -20;
+    }
+
+    setMotor(towerMotor, power);
+
+    if(power == 0 || settleUpdate(robot.towerSettle, halGetSensor(towerPot), power)) {
+        if(power != 0) {
+            logWarn(robot, LOG_CALLIBRATE_GAVE_UP, robot.towerSettle.status, 0, 0);
+            robot.calibrateFailed = true;
+        }
+
+        setMotor(towerMotor, 0);
+        settleReport(robot.log, robot.towerSettle, LOG_SETTLE_CALLIBRATE);
+        robot.calibrating = false;
+        robot.currentState = STATE_WAITING;
     }
 }
 
@@ -47,66 +74,261 @@ void callibrate() {
  * Checks the two buttons on the robot to see
  * if they have been pressed. When a button is
  * pressed the function will change the state
- * of the robot to whatever we want.
+ * of the robot to whatever we want. After a
+ * callibration gives up, the switches are
+ * ignored until they have been released.
+ *
+ * @param robot The robot's state.
+ */
+void waitingForButtons(Robot &robot) {
+    bool switches = halGetSensor(limitSwitch) || halGetSensor(button2);
+
+    if(!switches) {
+        robot.calibrateFailed = false;
+    }
+
+    if(halGetSensor(topButton)) {
+        missionBegin(robot.mission);
+        robot.currentState = USE_COMBINED_SCAN ? STATE_SCAN_ROTATE : STATE_SCAN;
+    }
+    if(switches && !robot.calibrateFailed) {
+        robot.currentState = STATE_RECALLIBRATE;
+    }
+}
+
+/**
+ * Picks the next state after a scan, and
+ * takes the ambient light level from it. If
+ * the lighthouse jammed before it saw anything
+ * that looks like the beacon, the part of the sweep
+ * it couldn't reach is turned into the part it
+ * can, by swinging the lighthouse back and
+ * turning the chassis, and the scan is tried
+ * again. If that fails too the lighthouse is
+ * recallibrated.
+ *
+ * @param robot The robot's state.
+ * @param status How the scan ended.
+ * @param scanState The state that runs the scan.
+ * @return The next state.
  */
-void waitingForButtons() {
-    if(SensorValue[topButton]) {
-        currentState = STATE_SCAN;
+RobotState afterScan(Robot &robot, SettleStatus status, RobotState scanState) {
+    lightRangeScanned(robot.lightRange);
+
+    if(status != SETTLE_STALLED || robot.highestValue > BEACON_FOUND_THRESH) {
+        robot.scanRetries = 0;
+        return STATE_ROTATE;
     }
-    if(SensorValue[limitSwitch]) {
-        currentState = STATE_RECALLIBRATE;
+
+    logWarn(robot, LOG_SCAN_STALLED, halGetSensor(towerPot), 0, 0);
+    setMotor(towerMotor, 0);
+
+    if(robot.scanRetries >= SCAN_STALL_RETRIES) {
+        robot.scanRetries = 0;
+        return STATE_RECALLIBRATE;
     }
-    if(SensorValue[button2]) {
-        currentState = STATE_RECALLIBRATE;
+    robot.scanRetries++;
+
+    float reached = towerAngle(robot);
+
+    if(rotateToDeg(robot, 2 * reached - 180, 100, 40, 100) == SETTLE_STALLED) {
+        robot.scanRetries = 0;
+        return STATE_RECALLIBRATE;
     }
+
+    rotate(robot, reached - 180, 40, 20, 200);
+    return scanState;
+}
+
+/**
+ * Swings the lighthouse back to the start of
+ * its sweep, so the next scan covers all of it
+ * rather than whatever is left from where the
+ * lighthouse stopped. The end stop may be
+ * reached before the target, which is fine.
+ *
+ * @param robot The robot's state.
+ * @return The state that runs the scan.
+ */
+RobotState rescan(Robot &robot) {
+    setMotor(towerMotor, 0);
+    rotateToDeg(robot, SCAN_START_DEG, 127, 40, 100);
+
+    return USE_COMBINED_SCAN ? STATE_SCAN_ROTATE : STATE_SCAN;
 }
 
 /**
  * Performs the scan for the target object
  * then changes the state of the robot to
  * rotate towards the found object.
+ *
+ * @param robot The robot's state.
+ */
+void scanForBeacon(Robot &robot) {
+    SettleStatus status = scanPID(robot, 180, 100, 40, 200);
+    robot.currentState = afterScan(robot, status, STATE_SCAN);
+}
+
+/**
+ * Performs the scan for the target object
+ * while the chassis is already turning towards
+ * it, then changes the state of the robot to
+ * finish whatever is left of the rotation.
+ *
+ * @param robot The robot's state.
  */
-void scanForBeacon() {
-    scanPID(180, 100, 40, 200);
-    currentState = STATE_ROTATE;
+void scanAndRotate(Robot &robot) {
+    int turnSpeed = robot.mission.scanTurnSpeed[robot.mission.current];
+    SettleStatus status = scanWhileRotating(robot, 180, 100, 40, 200, turnSpeed);
+    robot.currentState = afterScan(robot, status, STATE_SCAN_ROTATE);
 }
 
 /**
  * Rotates the robot towards the beacon
  * using the sensor value obtained from
- * the scanForBeacon function.
+ * the scanForBeacon function. If the sonar
+ * can see the beacon, the robot drives an arc
+ * towards it instead of turning on the spot,
+ * and the approach takes over on the move.
+ *
+ * @param robot The robot's state.
  */
-void rotateToBeacon() {
-    rotate((180-posInDegs), 40, 20, 200);
-    currentState = STATE_APPROACH;
+void rotateToBeacon(Robot &robot) {
+    SettleStatus status;
+    float degrees = 180 - robot.posInDegs;
+
+    // The lighthouse turns through more than a
+    // full circle, so take the short way round.
+    if(degrees > 180) {
+        degrees -= 360;
+    }
+    else if(degrees < -180) {
+        degrees += 360;
+    }
+
+    // Whatever the beacon was placed at last time
+    // is stale now; the arc places it again.
+    robot.beaconKnown = false;
+    bool arc = USE_ARC_APPROACH && arcStart(robot, degrees);
+
+    if(arc) {
+        // The arc is the start of the approach.
+        missionApproach(robot.mission);
+        status = arcDrive(robot, robot.mission.approachSpeed[robot.mission.current]);
+    }
+    else if(USE_FAST_TURN) {
+        status = rotateFast(robot, degrees, MAX_SPEED);
+    }
+    else {
+        status = rotate(robot, degrees, 40, 20, 200);
+    }
+
+    if(status == SETTLE_STALLED) {
+        // Something is holding the chassis. Back off
+        // it and look for the beacon again.
+        logWarn(robot, LOG_ROTATE_STALLED, 0, 0, 0);
+        quikBak(robot);
+        robot.currentState = rescan(robot);
+    }
+    else {
+        if(!arc) {
+            missionApproach(robot.mission);
+        }
+        robot.currentState = STATE_APPROACH;
+    }
 }
 
 /**
  * Approaches the beacon using an ultrasonic
  * sensor and terminates the approach when
  * the cable has been connected successfully.
+ * The cable guide is lowered on the way in.
+ *
+ * @param robot The robot's state.
  */
-void approachTarget() {
-    bool success = realTimeApproachNew(127);
+void approachTarget(Robot &robot) {
+    cableGuideStart(robot, true);
+
+    bool success = realTimeApproach(robot, robot.mission.approachSpeed[robot.mission.current]);
+
+    // A short approach can end before the guide is
+    // down; don't leave its motor running.
+    while(!cableGuideStep(robot)) {
+        execTick(robot.exec, robot.log);
+    }
 
     if(!success) {
-        currentState = STATE_SCAN;
+        robot.currentState = rescan(robot);
     }
     else {
-        currentState = STATE_DEPART;
+        missionConnected(robot.mission);
+        robot.currentState = STATE_DEPART;
     }
 }
 
 /**
  * Backs away from the target and turns after
- * the cable has successfully been connected.
+ * the cable has successfully been connected,
+ * raising the cable guide on the way.
+ * If the mission has another target, the
+ * lighthouse is swung back to the start of its
+ * sweep and the robot goes straight back to
+ * scanning. The pose and map are kept, so the
+ * next target is found from where the robot
+ * actually is.
+ *
+ * @param robot The robot's state.
  */
-void departTarget() {
-    motor[towerMotor] = 0;
-    quikBak();
+void departTarget(Robot &robot) {
+    setMotor(towerMotor, 0);
+    quikBakStart(robot);
+    cableGuideStart(robot, false);
 
     toggleRedLED();
     toggleRainbowLED();
 
-    currentState = STATE_DISABLED;
+    if(missionNext(robot.mission)) {
+        logInfo(robot, LOG_MISSION_TARGET, robot.mission.current + 1, robot.mission.count, 0);
+
+        // Swing the lighthouse back for the next scan
+        // while backing away. The end stop may be
+        // reached before the target, which is fine.
+        rotateToDegStart(robot, 40, 100);
+
+        bool swung = false;
+        bool backed = false;
+        bool raised = false;
+
+        while(true) {
+            swung = swung || rotateToDegStep(robot, SCAN_START_DEG, 127);
+            backed = quikBakStep(robot);
+            raised = cableGuideStep(robot);
+
+            if(swung && backed && raised) {
+                break;
+            }
+            execTick(robot.exec, robot.log);
+        }
+
+        robot.currentState = USE_COMBINED_SCAN ? STATE_SCAN_ROTATE : STATE_SCAN;
+    }
+    else {
+        bool backed = false;
+        bool raised = false;
+
+        while(true) {
+            backed = quikBakStep(robot);
+            raised = cableGuideStep(robot);
+
+            if(backed && raised) {
+                break;
+            }
+            execTick(robot.exec, robot.log);
+        }
+
+        missionReport(robot.mission);
+        robot.currentState = STATE_DISABLED;
+    }
 }
+
+#endif
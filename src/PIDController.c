@@ -8,15 +8,20 @@
  * @date January 16, 2018
  */
 
+#ifndef PIDCONTROLLER_C
+#define PIDCONTROLLER_C
+
 #include "Utils.c"
 #include "Constants.h"
+#include "Timebase.c"
+#include "Profiler.c"
 
 typedef struct {
     float P, I, D;
     float error;
     float errorSum, lastError;
     float output, lastOutput;
-    int lastTime;
+    long lastTime;
     bool zeroOnCross;
     float integralLimit, epsilon;
     float dTime;
@@ -56,6 +61,24 @@ void PIDInit(PID &pid, float kP, float kI, float kD, float integralLimit, float
     pid.refreshRate = refreshRate;
 }
 
+/**
+ * Changes the gains of a PID controller
+ * without resetting its state. Used by the
+ * gain scheduler.
+ *
+ * @param pid The PID controller to update.
+ * @param kP  The P value for the controller.
+ * @param kI  The I value for the controller.
+ * @param kD  The D value for the controller.
+ * @param slewRate The slew rate.
+ */
+void PIDSetGains(PID &pid, float kP, float kI, float kD, float slewRate) {
+    pid.P = kP;
+    pid.I = kI;
+    pid.D = kD;
+    pid.slewRate = slewRate;
+}
+
 /**
  * Resets all critical values for the PID
  * controller provided.
@@ -64,8 +87,8 @@ void PIDInit(PID &pid, float kP, float kI, float kD, float integralLimit, float
  */
 void PIDReset(PID &pid) {
     pid.error      = 0;
-    pid.lastTime   = 0;
-    pid.dTime      = 10; // dt is set to 10 to avoid divide by 0 error
+    pid.lastTime   = timeMicros();
+    pid.dTime      = 0; // measured on the first PIDCalculate
     pid.errorSum   = 0;
     pid.lastError  = 0;
     pid.output     = 0;
@@ -112,9 +135,9 @@ float PIDFilter(PID &pid) {
  * @return The output value of the PID controller.
  */
 float PIDCalculate(PID &pid, float error) {
+    profEnter(PROF_PID);
 
-    pid.dTime = nPgmTime - pid.lastTime;
-    pid.lastTime = nPgmTime;
+    pid.dTime = timeDeltaMs(pid.lastTime, pid.dTime);
 
     pid.lastError = pid.error;
     pid.error = error;
@@ -139,10 +162,10 @@ float PIDCalculate(PID &pid, float error) {
     pid.output += pid.I * pid.errorSum;
     pid.iterations++;
 
-    if(pid.iterations > 5) {
-        return PIDFilter(pid);
-    }
-    else {
-        return 0;
-    }
+    float out = pid.iterations > 5 ? PIDFilter(pid) : 0;
+
+    profExit(PROF_PID);
+    return out;
 }
+
+#endif
@@ -0,0 +1,351 @@
+/**
+ * This class contains the on-robot profiler.
+ * It is only built in with PROFILE_ENABLED set
+ * to 1 on the command line (or before HAL.h is
+ * included); otherwise every hook compiles to
+ * nothing and the robot pays nothing for it.
+ *
+ * Profiled functions call profEnter() and
+ * profExit() with their id. Each one gets a
+ * call count, its own time and its time
+ * including the profiled functions it calls.
+ * The Cortex has no cycle counter that ROBOTC
+ * can read and its clock only ticks in ms, so
+ * a single call usually reads as 0 or 1 ms;
+ * summed over thousands of calls the totals
+ * are still right.
+ *
+ * A sampling task wakes every PROFILE_SAMPLE
+ * ms and records the state machine's state
+ * and the outermost profiled function (the
+ * maneuver), and the innermost one. Samples
+ * with nothing on the stack were spent
+ * waiting for the next tick. The host
+ * backends have no tasks, so there the
+ * samples are taken whenever the simulated
+ * clock passes a sample time.
+ *
+ * profReport() writes a flat profile when the
+ * robot finishes.
+ *
+ * @author Jayden Chan
+ * @date April 20, 2018
+ */
+
+#ifndef PROFILER_C
+#define PROFILER_C
+
+#include "Constants.h"
+#include "RobotStates.h"
+#include "Timebase.c"
+#include "HAL.h"
+
+typedef enum ProfFunctionEnum {
+    PROF_APPROACH_STEP,
+    PROF_ROTATE_STEP,
+    PROF_SCAN_PASS,
+    PROF_DRIVE,
+    PROF_ROTATE,
+    PROF_ROTATE_FAST,
+    PROF_ARC_DRIVE,
+    PROF_MPC_PLAN,
+    PROF_AUTO_TRACK,
+    PROF_ODOMETRY,
+    PROF_PID,
+    PROF_LEFT_LIGHT,
+    PROF_RIGHT_LIGHT,
+    PROF_SONAR,
+    PROF_ENCODER,
+    PROF_FUNCTIONS
+} ProfFunction;
+
+#if PROFILE_ENABLED
+
+// The last column of the sample tables is for
+// samples with nothing on the stack.
+const int PROF_IDLE = PROF_FUNCTIONS;
+
+typedef struct {
+    long calls[PROF_FUNCTIONS];
+    long selfTime[PROF_FUNCTIONS];
+    long totalTime[PROF_FUNCTIONS];
+
+    // The profiled functions currently running,
+    // outermost first.
+    int stack[PROFILE_DEPTH];
+    long stackStart[PROFILE_DEPTH];
+    long stackChildren[PROFILE_DEPTH];
+    int depth;
+    int overflows;
+
+    int state;
+    long nextSample;
+    long samples;
+    long stateSamples[PROFILE_STATES][PROF_FUNCTIONS + 1];
+    long selfSamples[PROF_FUNCTIONS + 1];
+
+    long startTime;
+} Profiler;
+
+// Every simulated robot runs on its own host
+// thread, so each gets its own profile.
+#if defined(HAL_SIM) || defined(HAL_REPLAY)
+thread_local Profiler profiler;
+#else
+Profiler profiler;
+#endif
+
+/**
+ * Records one sample of what the robot is
+ * doing. On the robot this runs in its own
+ * task, which can wake up halfway through
+ * profEnter() or profExit(), so the depth is
+ * read once and checked before it is used.
+ */
+void profSample() {
+    int depth = profiler.depth;
+    int outer = PROF_IDLE;
+    int inner = PROF_IDLE;
+
+    if(depth > 0 && depth <= PROFILE_DEPTH) {
+        outer = profiler.stack[0];
+        inner = profiler.stack[depth - 1];
+    }
+
+    if(profiler.state >= 0 && profiler.state < PROFILE_STATES) {
+        profiler.stateSamples[profiler.state][outer]++;
+    }
+    profiler.selfSamples[inner]++;
+    profiler.samples++;
+}
+
+#if defined(HAL_SIM) || defined(HAL_REPLAY)
+
+/**
+ * Takes any samples that are due. Stands in
+ * for the sampling task on the host.
+ *
+ * @param now The current time in us.
+ */
+void profPoll(long now) {
+    while((long)(now - profiler.nextSample) >= 0) {
+        profSample();
+        profiler.nextSample += PROFILE_SAMPLE * 1000;
+    }
+}
+
+#else
+
+#define profPoll(now)
+
+/**
+ * Samples the profile in the background until
+ * the program ends.
+ */
+task profSampler() {
+    while(true) {
+        profSample();
+        wait1Msec(PROFILE_SAMPLE);
+    }
+}
+
+#endif
+
+/**
+ * Clears the profile and starts sampling.
+ */
+void profInit() {
+    for(int i = 0; i < PROF_FUNCTIONS; i++) {
+        profiler.calls[i] = 0;
+        profiler.selfTime[i] = 0;
+        profiler.totalTime[i] = 0;
+    }
+    for(int i = 0; i <= PROF_FUNCTIONS; i++) {
+        for(int j = 0; j < PROFILE_STATES; j++) {
+            profiler.stateSamples[j][i] = 0;
+        }
+        profiler.selfSamples[i] = 0;
+    }
+
+    profiler.depth = 0;
+    profiler.overflows = 0;
+    profiler.state = 0;
+    profiler.samples = 0;
+    profiler.startTime = timeMicros();
+    profiler.nextSample = profiler.startTime + PROFILE_SAMPLE * 1000;
+
+#if !defined(HAL_SIM) && !defined(HAL_REPLAY)
+    startTask(profSampler);
+#endif
+}
+
+/**
+ * Records the state machine's current state
+ * for the samples.
+ *
+ * @param state The current state.
+ */
+void profState(int state) {
+    profiler.state = state;
+}
+
+/**
+ * Marks the start of a call to a profiled
+ * function.
+ *
+ * @param fn The function's id.
+ */
+void profEnter(int fn) {
+    long now = timeMicros();
+    profPoll(now);
+
+    profiler.calls[fn]++;
+
+    if(profiler.depth == PROFILE_DEPTH) {
+        profiler.overflows++;
+        return;
+    }
+
+    profiler.stack[profiler.depth] = fn;
+    profiler.stackStart[profiler.depth] = now;
+    profiler.stackChildren[profiler.depth] = 0;
+    profiler.depth++;
+}
+
+/**
+ * Marks the end of a call to a profiled
+ * function. Must be called on every path out
+ * of a function that called profEnter().
+ *
+ * @param fn The function's id.
+ */
+void profExit(int fn) {
+    long now = timeMicros();
+    profPoll(now);
+
+    if(profiler.depth == 0 || profiler.stack[profiler.depth - 1] != fn) {
+        profiler.overflows++;
+        return;
+    }
+
+    profiler.depth--;
+    long took = now - profiler.stackStart[profiler.depth];
+
+    profiler.totalTime[fn] += took;
+    profiler.selfTime[fn] += took - profiler.stackChildren[profiler.depth];
+
+    if(profiler.depth > 0) {
+        profiler.stackChildren[profiler.depth - 1] += took;
+    }
+}
+
+/**
+ * Reads a drive encoder, counting and timing
+ * the read.
+ *
+ * @param port The motor the encoder is on.
+ * @return The encoder's count.
+ */
+long profGetEncoder(tMotor port) {
+    profEnter(PROF_ENCODER);
+    long ticks = halReadEncoder(port);
+    profExit(PROF_ENCODER);
+
+    return ticks;
+}
+
+/**
+ * Gets a profiled function's name.
+ *
+ * @param fn The function's id, or PROF_IDLE.
+ * @return The name.
+ */
+const char *profName(int fn) {
+    switch(fn) {
+    case PROF_APPROACH_STEP: return "approachStep";
+    case PROF_ROTATE_STEP:   return "rotateToDegStep";
+    case PROF_SCAN_PASS:     return "scan pass";
+    case PROF_DRIVE:         return "driveStraight";
+    case PROF_ROTATE:        return "rotate";
+    case PROF_ROTATE_FAST:   return "rotateFast";
+    case PROF_ARC_DRIVE:     return "arcDrive";
+    case PROF_MPC_PLAN:      return "mpcPlan";
+    case PROF_AUTO_TRACK:    return "betterAutoTrack";
+    case PROF_ODOMETRY:      return "odometryUpdate";
+    case PROF_PID:           return "PIDCalculate";
+    case PROF_LEFT_LIGHT:    return "getLeftLight";
+    case PROF_RIGHT_LIGHT:   return "getRightLight";
+    case PROF_SONAR:         return "getUltraSonic";
+    case PROF_ENCODER:       return "getMotorEncoder";
+    default:                 return "(waiting)";
+    }
+}
+
+/**
+ * Gets a state's name for the profile.
+ *
+ * @param state The state.
+ * @return The name.
+ */
+const char *profStateName(int state) {
+    switch(state) {
+    case STATE_DISABLED:     return "disabled";
+    case STATE_ENABLED:      return "enabled";
+    case STATE_WAITING:      return "waiting";
+    case STATE_RECALLIBRATE: return "callibrate";
+    case STATE_SCAN:         return "scan";
+    case STATE_SCAN_ROTATE:  return "scan rotate";
+    case STATE_ROTATE:       return "rotate";
+    case STATE_APPROACH:     return "approach";
+    case STATE_DEPART:       return "depart";
+    default:                 return "test";
+    }
+}
+
+/**
+ * Writes the flat profile to the debug stream:
+ * one line per profiled function, then the
+ * samples of each state split by maneuver.
+ */
+void profReport() {
+    float seconds = (timeMicros() - profiler.startTime) / 1000000.0;
+    float samples = profiler.samples > 0 ? profiler.samples : 1;
+
+    writeDebugStreamLine("profile: %.1f s, %d samples, %d stack errors", seconds, (int)profiler.samples, profiler.overflows);
+    writeDebugStreamLine("profile: %-16s %8s %8s %9s %9s %8s %6s", "function", "calls", "per s", "self ms", "total ms", "us/call", "self %");
+
+    for(int i = 0; i < PROF_FUNCTIONS; i++) {
+        if(profiler.calls[i] == 0) {
+            continue;
+        }
+
+        writeDebugStreamLine("profile: %-16s %8d %8.0f %9.1f %9.1f %8.1f %6.1f",
+            profName(i), (int)profiler.calls[i], profiler.calls[i] / seconds,
+            profiler.selfTime[i] / 1000.0, profiler.totalTime[i] / 1000.0,
+            (float)profiler.totalTime[i] / profiler.calls[i],
+            profiler.selfSamples[i] * 100 / samples);
+    }
+    writeDebugStreamLine("profile: %-16s %53.1f", profName(PROF_IDLE), profiler.selfSamples[PROF_IDLE] * 100 / samples);
+
+    for(int state = 0; state < PROFILE_STATES; state++) {
+        for(int i = 0; i <= PROF_FUNCTIONS; i++) {
+            if(profiler.stateSamples[state][i] > 0) {
+                writeDebugStreamLine("profile: %-12s %-16s %5.1f%%", profStateName(state), profName(i),
+                    profiler.stateSamples[state][i] * 100 / samples);
+            }
+        }
+    }
+}
+
+#else
+
+#define profInit()
+#define profState(state)
+#define profPoll(now)
+#define profReport()
+#define profEnter(fn)
+#define profExit(fn)
+
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * This class holds all of the robot's mutable
+ * control state in a single struct, which is
+ * passed explicitly to every function that
+ * needs it. Nothing in the control code keeps
+ * state in globals, so several robots can be
+ * simulated side by side in one process.
+ *
+ * Fields are grouped by how often they are
+ * touched: everything the approach loop uses
+ * every tick comes first and sits together,
+ * followed by the scan state, then the rarely
+ * used controllers and bookkeeping.
+ *
+ * @author Jayden Chan
+ * @date April 6, 2018
+ */
+
+#ifndef ROBOT_C
+#define ROBOT_C
+
+#include "Constants.h"
+#include "RobotStates.h"
+#include "PIDController.c"
+#include "SettleLoop.c"
+#include "GainSchedule.c"
+#include "LightRange.c"
+#include "OccupancyGrid.c"
+#include "Log.c"
+#include "Mission.c"
+#include "Executive.c"
+
+typedef enum RecoveryPhaseEnum {
+    RECOVER_NONE,
+    RECOVER_SLEW,
+    RECOVER_SWEEP,
+    RECOVER_FAILED
+} RecoveryPhase;
+
+typedef struct {
+    // Approach loop, touched every tick.
+    PID ultrasonicPID;
+    PID slavePID;
+    float averageOne[LIGHT_AVERAGES];
+    float averageTwo[LIGHT_AVERAGES];
+    float sonarLastOutput;
+    float sonarDT;
+    float lastDir;
+    float photosensorDefaultValue;
+    int lSensorDiff;
+    RecoveryPhase recovery;
+    long recoverStart;
+    float recoverTarget;
+    bool beaconKnown;
+    float beaconX, beaconY;
+    GainSchedule approachSchedule;
+    GainSchedule slaveSchedule;
+    LightRange lightRange;
+
+    // Pose and map, updated during scan, rotation and approach.
+    float poseX, poseY, poseTheta;
+    long lastLeftTicks, lastRightTicks;
+    long odometryTime;
+    float leftSpeed, rightSpeed;
+    long speedLeftTicks, speedRightTicks, speedTime;
+    OccupancyGrid grid;
+
+    // Scan.
+    PID lightPID;
+    float highestValue;
+    int pos;
+    float posInDegs;
+    float towerHead;
+    int scanRetries;
+
+    // Other maneuvers and the state machine.
+    PID slave2PID;
+    PID turnPID;
+    float turnAccel, turnDecel;
+    float backStartX, backStartY;
+    long backStartTime;
+    bool backing;
+    long guideEnd;
+    bool guideMoving, guideDown;
+    SettleLoop driveSettle;
+    SettleLoop towerSettle;
+    bool calibrating, calibrateFailed;
+    RobotState currentState;
+    Mission mission;
+    Executive exec;
+    Log log;
+} Robot;
+
+/**
+ * Puts the robot's state back to how it is
+ * when the program starts. The controllers
+ * themselves are set up by driveInit() and
+ * lightHouseInit().
+ *
+ * @param robot The robot to initialize.
+ */
+void robotInit(Robot &robot) {
+    for(int i = 0; i < LIGHT_AVERAGES; i++) {
+        robot.averageOne[i] = 0;
+        robot.averageTwo[i] = 0;
+    }
+
+    robot.sonarLastOutput = 0;
+    robot.sonarDT = 0;
+    robot.lastDir = 1;
+    robot.photosensorDefaultValue = 0;
+    robot.lSensorDiff = 0;
+    robot.recovery = RECOVER_NONE;
+    robot.recoverStart = 0;
+    robot.recoverTarget = 0;
+    robot.beaconKnown = false;
+    robot.beaconX = 0;
+    robot.beaconY = 0;
+    lightRangeInit(robot.lightRange);
+
+    robot.poseX = 0;
+    robot.poseY = 0;
+    robot.poseTheta = 0;
+    robot.lastLeftTicks = 0;
+    robot.lastRightTicks = 0;
+    robot.odometryTime = 0;
+    robot.leftSpeed = 0;
+    robot.rightSpeed = 0;
+    robot.speedLeftTicks = 0;
+    robot.speedRightTicks = 0;
+    robot.speedTime = 0;
+    gridInit(robot.grid);
+
+    robot.highestValue = 0;
+    robot.pos = 0;
+    robot.posInDegs = 0;
+    robot.towerHead = 0;
+    robot.scanRetries = 0;
+
+    robot.turnAccel = TURN_ACCEL;
+    robot.turnDecel = TURN_DECEL;
+    robot.backStartX = 0;
+    robot.backStartY = 0;
+    robot.backStartTime = 0;
+    robot.backing = false;
+    robot.guideEnd = 0;
+    robot.guideMoving = false;
+    robot.guideDown = false;
+    robot.calibrating = false;
+    robot.calibrateFailed = false;
+    robot.currentState = STATE_ENABLED;
+    missionInit(robot.mission, MISSION_TARGETS);
+    execInit(robot.exec, EXEC_PERIOD);
+    logInit(robot.log);
+}
+
+/**
+ * Writes the RAM used by the robot's state
+ * to the debug stream, section by section,
+ * and warns if it is over ROBOT_RAM_BUDGET.
+ * Sizes are whatever the current compiler
+ * uses, so run it on the robot for the real
+ * numbers.
+ *
+ * The Cortex has 64 KB of RAM, but the ROBOTC
+ * firmware, the task stacks and the debug
+ * stream's buffer take most of it. The budget
+ * keeps Robot to a small, fixed share of what
+ * is left, so that adding a feature has to
+ * make room for itself. On the host, long and
+ * pointers are twice their size on the
+ * Cortex, so a host report under the budget
+ * is under it on the robot too.
+ *
+ * @param robot The robot to report on.
+ */
+void robotRamReport(Robot &robot) {
+    int approach = sizeof(robot.ultrasonicPID) + sizeof(robot.slavePID)
+                 + sizeof(robot.averageOne) + sizeof(robot.averageTwo)
+                 + sizeof(robot.sonarLastOutput) + sizeof(robot.sonarDT)
+                 + sizeof(robot.lastDir) + sizeof(robot.photosensorDefaultValue)
+                 + sizeof(robot.lSensorDiff) + sizeof(robot.recovery)
+                 + sizeof(robot.recoverStart) + sizeof(robot.recoverTarget)
+                 + sizeof(robot.beaconKnown) + sizeof(robot.beaconX) + sizeof(robot.beaconY)
+                 + sizeof(robot.approachSchedule) + sizeof(robot.slaveSchedule)
+                 + sizeof(robot.lightRange);
+    int map      = sizeof(robot.poseX) + sizeof(robot.poseY) + sizeof(robot.poseTheta)
+                 + sizeof(robot.lastLeftTicks) + sizeof(robot.lastRightTicks) + sizeof(robot.odometryTime)
+                 + sizeof(robot.leftSpeed) + sizeof(robot.rightSpeed)
+                 + sizeof(robot.speedLeftTicks) + sizeof(robot.speedRightTicks) + sizeof(robot.speedTime)
+                 + sizeof(robot.grid);
+    int scan     = sizeof(robot.lightPID) + sizeof(robot.highestValue)
+                 + sizeof(robot.pos) + sizeof(robot.posInDegs) + sizeof(robot.towerHead)
+                 + sizeof(robot.scanRetries);
+    int other    = sizeof(robot.slave2PID) + sizeof(robot.turnPID)
+                 + sizeof(robot.turnAccel) + sizeof(robot.turnDecel)
+                 + sizeof(robot.backStartX) + sizeof(robot.backStartY)
+                 + sizeof(robot.backStartTime) + sizeof(robot.backing)
+                 + sizeof(robot.guideEnd) + sizeof(robot.guideMoving) + sizeof(robot.guideDown)
+                 + sizeof(robot.driveSettle) + sizeof(robot.towerSettle)
+                 + sizeof(robot.calibrating) + sizeof(robot.calibrateFailed)
+                 + sizeof(robot.currentState) + sizeof(robot.mission)
+                 + sizeof(robot.exec) + sizeof(robot.log);
+    int total    = sizeof(robot);
+
+    writeDebugStreamLine("RAM: approach %d, map %d, scan %d, other %d, padding %d", approach, map, scan, other, total - approach - map - scan - other);
+    writeDebugStreamLine("RAM: total %d of %d bytes", total, ROBOT_RAM_BUDGET);
+
+    if(total > ROBOT_RAM_BUDGET) {
+        writeDebugStreamLine("RAM: over budget by %d bytes", total - ROBOT_RAM_BUDGET);
+    }
+}
+
+#endif
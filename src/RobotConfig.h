@@ -0,0 +1,122 @@
+//======================================
+// Robot variants. We run the same code on
+// more than one chassis, so everything
+// that depends on the build of the robot
+// (wheels, gearing, track width, where
+// the sonar sits, which gain set the drive
+// loops use, and the port map) is picked
+// here at compile time.
+//
+// main.c keeps the ROBOTC wizard's one
+// port map, which is the competition
+// chassis'. The wizard writes a single
+// unconditional #pragma config block, so
+// any other chassis moves each name onto
+// its own port here, and CFG_SET_UP_PORTS() gives
+// those ports their types and directions
+// at startup. The host backends have no
+// ports, so none of this applies there.
+//
+// Pick a variant on the command line, or
+// before anything else is included:
+//   -DROBOT_VARIANT=VARIANT_PRACTICE
+//
+// Every value is a literal, and the
+// derived ones are plain expressions of
+// literals, so they fold at compile time
+// and no variant costs anything at run
+// time. ROBOT_GAINS can be overridden on
+// its own to try a gain set on the other
+// chassis.
+//======================================
+
+#ifndef ROBOTCONFIG_H
+#define ROBOTCONFIG_H
+
+#define VARIANT_OKARITO     1
+#define VARIANT_PRACTICE    2
+
+#define GAINS_393_TORQUE    1
+#define GAINS_393_SPEED     2
+
+#ifndef ROBOT_VARIANT
+#define ROBOT_VARIANT VARIANT_OKARITO
+#endif
+
+#if ROBOT_VARIANT == VARIANT_OKARITO
+
+// Competition chassis: 4" wheels on 393s with
+// the high torque gears.
+#define ROBOT_VARIANT_NAME      "okarito"
+#define CFG_WHEEL_DIAMETER      10.16       // cm
+#define CFG_TICKS_PER_ROT       627.2       // ticks
+#define CFG_DRIVETRAIN_WIDTH    21.78       // cm
+#define CFG_SONAR_OFFSET        15          // cm
+#define CFG_DRIVE_TOP_SPEED     55          // cm/s
+#define CFG_WHEEL_TAU           0.08        // s
+#define CFG_GAINS               GAINS_393_TORQUE
+
+// The wizard's port map in main.c.
+#define CFG_SET_UP_PORTS()
+
+#elif ROBOT_VARIANT == VARIANT_PRACTICE
+
+// Practice chassis: 3.25" wheels on 393s with
+// the high speed gears and a wider base.
+#define ROBOT_VARIANT_NAME      "practice"
+#define CFG_WHEEL_DIAMETER      8.255       // cm
+#define CFG_TICKS_PER_ROT       392         // ticks
+#define CFG_DRIVETRAIN_WIDTH    27.3        // cm
+#define CFG_SONAR_OFFSET        12          // cm
+#define CFG_DRIVE_TOP_SPEED     50          // cm/s
+#define CFG_WHEEL_TAU           0.1         // s
+#define CFG_GAINS               GAINS_393_SPEED
+
+#if !defined(HAL_SIM) && !defined(HAL_REPLAY)
+
+// Port map. The wizard ties each IME to the
+// competition chassis' motor ports, so the
+// encoders are read by their I2C port
+// instead (see HAL.h). The right side is
+// reversed, so its count is negated.
+#define rightLightSensor        in1
+#define lightSensor2            in2
+#define lightSensor             in3
+#define button2                 dgtl2
+#define ultrasonic              dgtl5
+#define LED1                    dgtl11
+#define LED2                    dgtl12
+#define leftMotor               port1
+#define cableMotor              port5
+#define towerMotor              port6
+#define rightMotor              port10
+#define CFG_LEFT_ENCODER        I2C_2
+#define CFG_RIGHT_ENCODER       I2C_1
+
+#define CFG_SET_UP_PORTS() {                    \
+    SensorType[dgtl2] = sensorTouch;            \
+    SensorType[dgtl10] = sensorNone;            \
+    SensorType[in1] = sensorReflection;         \
+    SensorType[in2] = sensorReflection;         \
+    SensorType[in3] = sensorReflection;         \
+    SensorType[dgtl5] = sensorSONAR_cm;         \
+    SensorType[dgtl12] = sensorDigitalOut;      \
+    bMotorReflected[port1] = false;             \
+    bMotorReflected[port10] = true;             \
+}
+
+#endif
+
+#else
+#error "Unknown ROBOT_VARIANT"
+#endif
+
+#ifndef ROBOT_GAINS
+#define ROBOT_GAINS CFG_GAINS
+#endif
+
+// Derived values.
+#define CFG_WHEEL_CIRC          (3.14159265359 * CFG_WHEEL_DIAMETER)
+#define CFG_TICKS_PER_CM        (CFG_TICKS_PER_ROT / CFG_WHEEL_CIRC)
+
+#endif
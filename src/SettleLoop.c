@@ -0,0 +1,167 @@
+/**
+ * This class contains the settle-loop engine
+ * shared by every closed-loop maneuver. The
+ * maneuver computes its own error and sets
+ * its own motors, and the executive paces it
+ * (see Executive.c). The settle loop decides
+ * when it has settled (error band, dwell,
+ * timeout and velocity) and keeps timing
+ * statistics for every run.
+ *
+ * It also acts as a stall watchdog: if the
+ * motors are being driven hard but the error
+ * has barely moved for STALL_WINDOW, the
+ * mechanism is jammed and the maneuver is
+ * stopped with SETTLE_STALLED.
+ *
+ * @author Jayden Chan
+ * @date April 2, 2018
+ */
+
+#ifndef SETTLELOOP_C
+#define SETTLELOOP_C
+
+#include "Utils.c"
+#include "Constants.h"
+#include "Timebase.c"
+#include "Log.c"
+
+typedef enum SettleStatusEnum {
+    SETTLE_RUNNING,
+    SETTLE_DONE,
+    SETTLE_TIMEOUT,
+    SETTLE_STALLED
+} SettleStatus;
+
+typedef struct {
+    float errorBand;
+    float velocityBand;
+    int dwell;
+    int timeout;
+
+    long startTime, lastTime;
+    float lastError, errorRate;
+    float safeTime;
+    SettleStatus status;
+
+    float stallVelocity;
+    float stallTime, stallError;
+
+    int iterations;
+} SettleLoop;
+
+/**
+ * Sets up the settle policy for a maneuver
+ * and resets the loop's state. Call this
+ * right before entering the maneuver loop.
+ *
+ * @param loop The settle loop to initialize.
+ * @param errorBand The acceptable range around
+ * the target to finish in.
+ * @param dwell The time required to be inside
+ * the error band before finishing.
+ * @param timeout The max time the maneuver may
+ * take, or 0 for no limit.
+ * @param velocityBand The error rate (per ms)
+ * below which the maneuver is considered
+ * stopped, letting it finish after only
+ * SETTLE_FAST_DWELL. 0 disables this check.
+ * @param stallVelocity The average error rate
+ * (per ms) below which a maneuver driven with
+ * at least STALL_POWER is considered stalled.
+ * 0 disables the stall watchdog.
+ */
+void settleInit(SettleLoop &loop, float errorBand, int dwell, int timeout, float velocityBand, float stallVelocity) {
+    loop.errorBand = errorBand;
+    loop.velocityBand = velocityBand;
+    loop.dwell = dwell;
+    loop.timeout = timeout;
+
+    loop.startTime = timeMicros();
+    loop.lastTime = loop.startTime;
+    loop.lastError = 0;
+    loop.errorRate = 0;
+    loop.safeTime = 0;
+    loop.status = SETTLE_RUNNING;
+
+    loop.stallVelocity = stallVelocity;
+    loop.stallTime = 0;
+    loop.stallError = 0;
+
+    loop.iterations = 0;
+}
+
+/**
+ * Finishes one iteration of a maneuver by
+ * updating the settle state with the latest
+ * error. Call it after execTick(), so the
+ * error rate is measured over a whole tick.
+ *
+ * @param loop The settle loop to update.
+ * @param error The maneuver's current error.
+ * @param power The power the maneuver is
+ * currently commanding.
+ * @return Whether the maneuver should stop.
+ */
+bool settleUpdate(SettleLoop &loop, float error, float power) {
+    float dTime = timeDeltaMs(loop.lastTime, 0);
+
+    if(loop.iterations > 0 && dTime != 0) {
+        loop.errorRate = (error - loop.lastError) / dTime;
+    }
+    loop.lastError = error;
+    loop.iterations++;
+
+    // Watch for a stall over a whole window rather
+    // than tick by tick, so encoder quantization
+    // doesn't look like a stopped motor.
+    bool stalled = false;
+
+    if(loop.stallVelocity > 0 && abs(power) >= STALL_POWER) {
+        loop.stallTime += dTime;
+
+        if(loop.stallTime >= STALL_WINDOW) {
+            stalled = abs(error - loop.stallError) / loop.stallTime < loop.stallVelocity;
+            loop.stallTime = 0;
+            loop.stallError = error;
+        }
+    }
+    else {
+        loop.stallTime = 0;
+        loop.stallError = error;
+    }
+
+    loop.safeTime = abs(error) < loop.errorBand ? loop.safeTime + dTime : 0;
+
+    bool stopped = loop.velocityBand > 0 && abs(loop.errorRate) < loop.velocityBand;
+
+    if(loop.safeTime > loop.dwell || (stopped && loop.safeTime > SETTLE_FAST_DWELL)) {
+        loop.status = SETTLE_DONE;
+    }
+    else if(stalled) {
+        loop.status = SETTLE_STALLED;
+    }
+    else if(loop.timeout != 0 && (long)(loop.lastTime - loop.startTime) / 1000 > loop.timeout) {
+        loop.status = SETTLE_TIMEOUT;
+    }
+
+    return loop.status != SETTLE_RUNNING;
+}
+
+/**
+ * Logs the timing statistics of the last run
+ * of a settle loop at debug level. Call it
+ * when the maneuver finishes. Below
+ * LOG_LEVEL_DEBUG it records nothing.
+ *
+ * @param log The log to record into.
+ * @param loop The settle loop to report.
+ * @param message The maneuver's settle message.
+ */
+void settleReport(Log &log, SettleLoop &loop, LogMessage message) {
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    logRecord(log, LOG_LEVEL_DEBUG, 0, message, loop.status, (loop.lastTime - loop.startTime) / 1000, loop.iterations);
+#endif
+}
+
+#endif
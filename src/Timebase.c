@@ -0,0 +1,81 @@
+/**
+ * This class provides the monotonic timebase
+ * used by the PID controllers and the settle
+ * loop. Time is kept in microseconds and
+ * deltas are returned as fractional
+ * milliseconds, so all of the existing gains
+ * keep their units.
+ *
+ * ROBOTC only exposes a millisecond clock on
+ * the Cortex, so on the robot a 1 ms loop can
+ * read as 1 or 2 ms. On that backend the
+ * deltas are low-pass filtered to keep the
+ * derivative term from jumping by 2x. The
+ * filter only smooths the deltas; it adds no
+ * resolution. Sub-millisecond timing exists
+ * only in the host backends, which have a
+ * real microsecond clock and are not
+ * filtered.
+ *
+ * The microsecond clock is a long, which on
+ * the Cortex wraps after about 35 minutes. A
+ * difference between two times is still right
+ * across the wrap, so times are only ever
+ * compared through one: (long)(a - b) > 0 for
+ * a after b. Timestamps that are kept for
+ * reporting use timeMillis() instead.
+ *
+ * @author Jayden Chan
+ * @date April 4, 2018
+ */
+
+#ifndef TIMEBASE_C
+#define TIMEBASE_C
+
+#include "Constants.h"
+#include "HAL.h"
+
+/**
+ * Gets the current time.
+ *
+ * @return The time since the program started
+ * in microseconds.
+ */
+long timeMicros() {
+    return halGetMicros();
+}
+
+/**
+ * Gets the current time in milliseconds.
+ *
+ * @return The time since the program started
+ * in milliseconds.
+ */
+long timeMillis() {
+    return halGetMillis();
+}
+
+/**
+ * Measures the time since a timestamp and
+ * moves the timestamp to now.
+ *
+ * @param lastMicros The previous timestamp,
+ * updated to the current time.
+ * @param lastDelta The previous delta, used to
+ * filter coarse clocks. Pass 0 when there is
+ * no previous delta.
+ * @return The elapsed time in milliseconds.
+ */
+float timeDeltaMs(long &lastMicros, float lastDelta) {
+    long now = halGetMicros();
+    float delta = (long)(now - lastMicros) / 1000.0;
+    lastMicros = now;
+
+    if(HAL_TIMER_RESOLUTION >= 1000 && lastDelta > 0) {
+        delta = lastDelta + TIMEBASE_FILTER * (delta - lastDelta);
+    }
+
+    return delta;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * This class converts the tower pot into the
+ * lighthouse's angle. The angle is measured
+ * from the back of the robot, clockwise, so
+ * 180 is straight ahead.
+ *
+ * The pot is taken as linear: TICKS_PER_DEG
+ * ticks a degree, with 0 deg at POT_ZERO in
+ * the middle of the gear play. Both come from
+ * the scan offsets tuned on the robot, -800
+ * ticks for scans that started below
+ * POT_TRACKING_THRESH and -895 for the rest.
+ * Their mean, less SCAN_SENSOR_OFFSET, is
+ * POT_ZERO, and the 95 ticks between them are
+ * the POT_BACKLASH degrees of play in the
+ * gears between the pot and the head.
+ *
+ * The head is tracked through the play: while
+ * the pot moves one way the head trails it by
+ * half the play, and when the pot turns around
+ * the head stays put until the play has been
+ * taken up on the other side, so the angle is
+ * right in either direction of travel.
+ *
+ * @author Jayden Chan
+ * @date April 19, 2018
+ */
+
+#ifndef TOWERANGLE_C
+#define TOWERANGLE_C
+
+#include "Constants.h"
+#include "Robot.c"
+#include "Utils.c"
+#include "HAL.h"
+
+/**
+ * Converts a pot reading to the middle of the
+ * head's play, in degrees.
+ *
+ * @param pot The pot reading.
+ * @return The angle in degrees.
+ */
+float potToDegrees(float pot) {
+    return (pot - POT_ZERO) / TICKS_PER_DEG;
+}
+
+/**
+ * Converts an angle to the pot reading at the
+ * middle of the head's play.
+ *
+ * @param degrees The angle in degrees.
+ * @return The pot reading.
+ */
+float degreesToPot(float degrees) {
+    return degrees * TICKS_PER_DEG + POT_ZERO;
+}
+
+/**
+ * Updates the lighthouse's angle from a pot
+ * reading the caller already has, taking up
+ * the play in the direction the pot has moved.
+ *
+ * @param robot The robot's state.
+ * @param pot The pot reading.
+ * @return The head's angle in degrees.
+ */
+float towerAngleFrom(Robot &robot, float pot) {
+    float degrees = potToDegrees(pot);
+
+    robot.towerHead = clamp2(robot.towerHead, degrees - POT_BACKLASH / 2, degrees + POT_BACKLASH / 2);
+    return robot.towerHead;
+}
+
+/**
+ * Reads the lighthouse's angle, taking up the
+ * play in the direction the pot has moved.
+ * Call it every tick while the lighthouse is
+ * moving, so a change of direction isn't
+ * missed.
+ *
+ * @param robot The robot's state.
+ * @return The head's angle in degrees.
+ */
+float towerAngle(Robot &robot) {
+    return towerAngleFrom(robot, halGetSensor(towerPot));
+}
+
+#endif
@@ -2,16 +2,35 @@
  * This is a wrapper class for the ultrasonic
  * sensor. It is responsible for filtering the
  * bad values from the sensor and making it easy
- * for us to get a clean value.
+ * for us to get a clean value, and for
+ * fusing it with the range from the beacon's
+ * brightness.
  *
  * @author Jayden Chan
  * @date February 16, 2018
  */
 
+#ifndef ULTRASONIC_C
+#define ULTRASONIC_C
+
 #include "Utils.c"
+#include "Robot.c"
+#include "Profiler.c"
+#include "HAL.h"
 
-float lastOutput;
-float dT;
+/**
+ * Checks whether a raw sonar reading is a real
+ * range: not a dropout (-1) or 0, and short of
+ * the GRID_SONAR_MAX clamp. Every use of the
+ * raw sonar goes through this, so they all
+ * agree on the boundary.
+ *
+ * @param raw The raw sonar reading.
+ * @return Whether the reading can be used.
+ */
+bool sonarValid(int raw) {
+    return raw > 0 && raw < GRID_SONAR_MAX;
+}
 
 /**
  * Prevents the ultrasonic sensor from
@@ -21,11 +40,15 @@ float dT;
  * @return The value of the ultrasonic sensor.
  */
 float getUltraSonic() {
-    if(SensorValue[ultrasonic] == -1) {
-        return 20;
+    profEnter(PROF_SONAR);
+
+    float range = 20;
+    if(halGetSensor(ultrasonic) != -1) {
+        range = clamp((float)halGetSensor(ultrasonic), 150);
     }
 
-    return clamp((float)SensorValue[ultrasonic], 150);
+    profExit(PROF_SONAR);
+    return range;
 }
 
 /**
@@ -33,17 +56,90 @@ float getUltraSonic() {
  * ultrasonic output to avoid it spiking
  * like crazy.
  *
+ * @param robot The robot's state.
  * @return The filtered ultrasonic value.
  */
-float getUltraSonicFiltered() {
+float getUltraSonicFiltered(Robot &robot) {
     float toReturn = getUltraSonic();
 
-    if(dT != 0) {
-        if(abs(toReturn - lastOutput) / dT > ULTRASONIC_SLEW) {
-            toReturn = lastOutput + ULTRASONIC_SLEW * dT * sign(toReturn - lastOutput);
+    if(robot.sonarDT != 0) {
+        if(abs(toReturn - robot.sonarLastOutput) / robot.sonarDT > ULTRASONIC_SLEW) {
+            toReturn = robot.sonarLastOutput + ULTRASONIC_SLEW * robot.sonarDT * sign(toReturn - robot.sonarLastOutput);
         }
     }
 
-    lastOutput = toReturn;
+    robot.sonarLastOutput = toReturn;
     return toReturn;
 }
+
+/**
+ * Gets the range to the beacon, measured the
+ * way the sonar measures it. While the sonar
+ * has the beacon, its range is fused with the
+ * one from the beacon's brightness, each
+ * weighted by how far it can be trusted, and
+ * the pair goes into the brightness fit. Past
+ * the sonar's reach, or with the beacon
+ * outside its cone, the brightness range is
+ * used on its own. With neither, this is the
+ * filtered sonar, as it always was.
+ *
+ * The brightness comes from the lighthouse's
+ * averaged readings, so call it while the
+ * lighthouse is tracking.
+ *
+ * @param robot The robot's state.
+ * @param raw The raw sonar reading for this
+ * tick.
+ * @param range The range to the beacon in cm.
+ * @return Whether the range is known to be to
+ * the beacon, rather than whatever the sonar
+ * is pointing at.
+ */
+bool getBeaconRange(Robot &robot, int raw, float &range) {
+    float sonar = getUltraSonicFiltered(robot);
+
+    float left = 0;
+    float right = 0;
+    for(int i = 0; i < LIGHT_AVERAGES; i++) {
+        left += robot.averageOne[i];
+        right += robot.averageTwo[i];
+    }
+    left /= LIGHT_AVERAGES;
+    right /= LIGHT_AVERAGES;
+    float light = (left + right) / 2;
+
+    // Until the lighthouse has settled on the
+    // beacon the light says nothing about range,
+    // and the tower angle says nothing about
+    // whether the sonar is on the beacon.
+    bool tracking = robot.recovery == RECOVER_NONE && robot.beaconKnown;
+    bool sonarOk = tracking && sonarValid(raw) && abs(robot.towerHead - 180) < SONAR_CONE;
+
+    if(sonarOk && (left > BEACON_FOUND_THRESH || right > BEACON_FOUND_THRESH)) {
+        lightRangeAdd(robot.lightRange, light, sonar);
+    }
+
+    range = sonar;
+
+    float lightRange;
+    if(!tracking || !lightRangeGet(robot.lightRange, light, lightRange)) {
+        return sonarOk;
+    }
+
+    logDebugEvery(robot, 250, LOG_RANGE, sonarOk ? sonar : -1, lightRange, light);
+
+    if(!sonarOk) {
+        range = lightRange;
+        return true;
+    }
+
+    float lightSigma = LIGHT_SIGMA_MIN + LIGHT_RANGE_SIGMA * lightRange;
+    float sonarWeight = 1 / (SONAR_SIGMA * SONAR_SIGMA);
+    float lightWeight = 1 / (lightSigma * lightSigma);
+
+    range = (sonar * sonarWeight + lightRange * lightWeight) / (sonarWeight + lightWeight);
+    return true;
+}
+
+#endif
@@ -9,6 +9,9 @@
  * @date January 12, 2018
  */
 
+#ifndef UTILS_C
+#define UTILS_C
+
 /**
  * Returns the sign of the input. If the input
  * is positive, its sign is (+1), if it's
@@ -54,3 +57,5 @@ float clamp2(float input, float min, float max) {
         return input;
     }
 }
+
+#endif
@@ -29,10 +29,14 @@
  * @date January 10, 2018
  */
 
+#include "HAL.h"
 #include "Okarito.c"
 
 void cleanup();
-void init();
+void init(Robot &robot);
+void runRobot(Robot &robot);
+
+Robot robot;
 
 //===============================================================
 //    DO NOT MODIFY THIS FILE EXCEPT TO ADD NEW ROBOT STATES
@@ -40,46 +44,67 @@ void init();
 //===============================================================
 
 /**
- * The main method for the program. Contains
- * the finite state machine to control the
- * robot's actions.
+ * The main method for the program. Runs the
+ * state machine on the robot's state.
  */
 task main() {
-    init();
+    runRobot(robot);
+}
+
+/**
+ * Contains the finite state machine to control
+ * the robot's actions. All of the robot's
+ * state lives in the struct that is passed in,
+ * so the simulator can run several of these
+ * side by side.
+ *
+ * @param robot The robot's state.
+ */
+void runRobot(Robot &robot) {
+    init(robot);
 
     // Finite state machine implementation.
     // All functions here can be found in
     // Okarito.c
-    while(currentState != STATE_DISABLED) {
-        switch(currentState) {
+    while(robot.currentState != STATE_DISABLED) {
+        profState(robot.currentState);
+
+        switch(robot.currentState) {
         case STATE_ENABLED:
-            currentState = STATE_WAITING;
+            robot.currentState = STATE_WAITING;
             break;
         case STATE_WAITING:
-            waitingForButtons();
+            waitingForButtons(robot);
             break;
         case STATE_RECALLIBRATE:
-            callibrate();
+            callibrate(robot);
             break;
         case STATE_SCAN:
-            scanForBeacon();
+            scanForBeacon(robot);
+            break;
+        case STATE_SCAN_ROTATE:
+            scanAndRotate(robot);
             break;
         case STATE_ROTATE:
-            rotateToBeacon();
+            rotateToBeacon(robot);
             break;
         case STATE_APPROACH:
-            approachTarget();
+            approachTarget(robot);
             break;
         case STATE_DEPART:
-            departTarget();
+            departTarget(robot);
             break;
         case STATE_TEST:
-            testPeriodic();
+            testPeriodic(robot);
             break;
          default:
             writeDebugStreamLine("Inside default switch block");
         }
+        logFlush(robot.log);
+        execTick(robot.exec, robot.log);
     }
+    execReport(robot.exec);
+    lightRangeReport(robot.lightRange);
     cleanup();
 }
 
@@ -89,25 +114,39 @@ task main() {
  * stream, initializes the drivebase, and waits
  * for a small amount of time to let any sensor
  * values settle.
+ *
+ * @param robot The robot's state.
  */
-void init() {
+void init(Robot &robot) {
+    halSetUpPorts();
     clearDebugStream();
+    writeDebugStreamLine("variant: %s, %.2f ticks/cm, %.2f cm track", ROBOT_VARIANT_NAME, TICKS_PER_CM2, DRIVETRAIN_WIDTH);
+    robotInit(robot);
+    robotRamReport(robot);
     turnOffAllLED();
-    driveInit();
-    lightHouseInit();
+    driveInit(robot);
+    lightHouseInit(robot);
     wait1Msec(250);
+
+    // Start the tick grid once the sensors have
+    // settled.
+    execInit(robot.exec, EXEC_PERIOD);
+    profInit();
 }
 
 /**
  * Cleanup code for the robot to execute when
  * it is finished it's routine. Simply turns
- * off all the motors and resets the encoders.
+ * off all the motors and resets the encoders,
+ * then writes the profile if it is built in.
  */
 void cleanup() {
-    motor[rightMotor] = 0;
-    motor[leftMotor]  = 0;
-    motor[towerMotor] = 0;
-    motor[cableMotor] = 0;
-    resetMotorEncoder(rightMotor);
-    resetMotorEncoder(leftMotor);
+    halSetMotor(rightMotor, 0);
+    halSetMotor(leftMotor, 0);
+    halSetMotor(towerMotor, 0);
+    halSetMotor(cableMotor, 0);
+    halResetEncoder(rightMotor);
+    halResetEncoder(leftMotor);
+
+    profReport();
 }